@@ -11,15 +11,184 @@
  * @copyright Copyright (c) 2024
  * 
  */
+#include <stdio.h>
+#include <stdarg.h>
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "memory.h"
 #include "buffer.h"
 #include "myassert.h"
+#include "stats.h"
+#include "bytes.h"
 
 #define MIN(l, r) (((l)<(r))?(l):(r))
 
+// number of buffers given to one writev() call
+#define WRITE_IOV 64
+
+// files at least this large are mapped instead of read
+#define MAP_THRESHOLD (1024 * 64)
+
+// Backing stores from 32 bytes to just under 8K are recycled, up to 
+// POOL_DEPTH in each power of two class and of the headers. Stores keep 
+// the size they were allocated with, and a class holds the stores that are 
+// at least its size but smaller than the next one.
+#define POOL_MIN_SHIFT  5
+#define POOL_CLASSES    8
+#define POOL_DEPTH      32
+
+typedef struct _pool_block_ {
+    struct _pool_block_* next;
+    size_t cap;     // the real size of the store
+} _pool_block_;
+
+typedef struct {
+    Buffer* headers;    // linked through the buffer field
+    int nheaders;
+    _pool_block_* stores[POOL_CLASSES];
+    int nstores[POOL_CLASSES];
+} _buffer_pool_t_;
+
+// each thread recycles its own buffers, so no locking is needed
+static _Thread_local _buffer_pool_t_ pool;
+
+// drains the pool of a thread that exits while it holds anything
+static pthread_key_t pool_key;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static _Thread_local int pool_watched;
+
+typedef struct {
+    const BufferSubst* subs;
+    int count;
+    int lead;                   // first byte of every pattern, or -1
+    unsigned char first[256];   // set for the first byte of any pattern
+} _subst_t_;
+
+static void pool_exit(void* ptr) {
+
+    (void)ptr;
+    drain_buffer_pool();
+}
+
+static void make_pool_key() {
+
+    pthread_key_create(&pool_key, pool_exit);
+}
+
+/**
+ * @brief Called before anything is kept in the pool. The first time in a 
+ * thread, it arranges for the pool to be drained when the thread exits, so 
+ * threads that never call drain_buffer_pool() do not leak it.
+ * 
+ */
+static inline void watch_pool() {
+
+    if(!pool_watched) {
+        pthread_once(&pool_once, make_pool_key);
+        pthread_setspecific(pool_key, &pool);
+        pool_watched = 1;
+    }
+}
+
+/**
+ * @brief Return the smallest size class that holds cap bytes, or -1 if it 
+ * is too large to be pooled.
+ * 
+ * @param cap 
+ * @return int 
+ */
+static inline int size_class(size_t cap) {
+
+    int k = 0;
+    while(((size_t)1 << (k + POOL_MIN_SHIFT)) < cap) {
+        if(++k >= POOL_CLASSES)
+            return -1;
+    }
+
+    return k;
+}
+
+/**
+ * @brief Return the largest size class that a store of cap bytes can serve, 
+ * or -1 if it is too small or too large to be pooled.
+ * 
+ * @param cap 
+ * @return int 
+ */
+static inline int store_class(size_t cap) {
+
+    if(cap < ((size_t)1 << POOL_MIN_SHIFT) || 
+            cap >= ((size_t)1 << (POOL_MIN_SHIFT + POOL_CLASSES)))
+        return -1;
+
+    int k = 0;
+    while(((size_t)2 << (k + POOL_MIN_SHIFT)) <= cap)
+        k++;
+
+    return k;
+}
+
+static inline size_t class_size(int k) {
+
+    return (size_t)1 << (k + POOL_MIN_SHIFT);
+}
+
+/**
+ * @brief Return heap storage for at least *cap bytes and set *cap to its 
+ * real size. The class that *cap falls in is tried first, if the store at 
+ * its head is large enough, and then the next class up, where every store 
+ * is. Otherwise exactly *cap bytes are allocated.
+ * 
+ * @param cap 
+ * @return unsigned char* 
+ */
+static unsigned char* take_store(size_t* cap) {
+
+    int k = store_class(*cap);
+    if(k < 0 || pool.stores[k] == NULL || pool.stores[k]->cap < *cap)
+        k = size_class(*cap);
+
+    if(k >= 0 && pool.stores[k] != NULL) {
+        _pool_block_* blk = pool.stores[k];
+        pool.stores[k] = blk->next;
+        pool.nstores[k]--;
+        *cap = blk->cap;
+        STAT_INC(pool_hits);
+        return (unsigned char*)blk;
+    }
+
+    return _ALLOC_DS_ARRAY(unsigned char, *cap);
+}
+
+/**
+ * @brief Give heap storage back to the pool, or free it if it is not a 
+ * pooled size or the pool is full.
+ * 
+ * @param ptr 
+ * @param cap 
+ */
+static void give_store(unsigned char* ptr, size_t cap) {
+
+    int k = store_class(cap);
+    if(k >= 0 && pool.nstores[k] < POOL_DEPTH) {
+        watch_pool();
+        _pool_block_* blk = (_pool_block_*)ptr;
+        blk->cap = cap;
+        blk->next = pool.stores[k];
+        pool.stores[k] = blk;
+        pool.nstores[k]++;
+    }
+    else
+        _FREE(ptr);
+}
+
 /**
  * @brief This returns a positive integer that represents the actual index 
  * into the list. If a negative value is returned, then the index lays outside
@@ -40,115 +209,900 @@ static inline int normalize_index(Buffer* buf, int idx) {
 }
 
 /**
- * @brief Resize the buffer if it's too small to handle the additional length.
- * Otherwise do nothing.
+ * @brief Move the contents into storage of exactly cap bytes, which must be 
+ * more than the length. Capacities that fit are stored inline.
+ * 
+ * @param buf 
+ * @param cap 
+ */
+static void set_capacity(Buffer* buf, size_t cap) {
+
+    ASSERT(cap > buf->length);
+
+    if(cap <= BUFFER_INLINE_SIZE) {
+        if(buf->buffer != buf->local) {
+            memcpy(buf->local, buf->buffer, buf->length + 1);
+            give_store(buf->buffer, buf->capacity);
+            buf->buffer = buf->local;
+        }
+        cap = BUFFER_INLINE_SIZE;
+    }
+    else if(buf->buffer == buf->local) {
+        buf->buffer = take_store(&cap);
+        memcpy(buf->buffer, buf->local, buf->length + 1);
+    }
+    else if(size_class(cap) >= 0 || store_class(buf->capacity) >= 0) {
+        // pooled sizes move to another store instead of being reallocated
+        unsigned char* ptr = take_store(&cap);
+        memcpy(ptr, buf->buffer, buf->length + 1);
+        give_store(buf->buffer, buf->capacity);
+        buf->buffer = ptr;
+    }
+    else
+        buf->buffer = _REALLOC_DS_ARRAY(buf->buffer, unsigned char, cap);
+
+    buf->capacity = cap;
+}
+
+/**
+ * @brief Return the capacity that the growth policy of the buffer gives to 
+ * hold at least need bytes.
+ * 
+ * @param buf 
+ * @param need 
+ * @return size_t 
+ */
+static size_t next_capacity(Buffer* buf, size_t need) {
+
+    size_t cap = buf->capacity;
+
+    switch(buf->growth) {
+        case GROW_CHUNK:
+            cap += ((need - cap + buf->chunk - 1) / buf->chunk) * buf->chunk;
+            break;
+        case GROW_HALF:
+            while(cap < need)
+                cap += (cap >> 1) + 1;
+            break;
+        default:
+            while(cap < need)
+                cap <<= 1;
+            break;
+    }
+
+    return cap;
+}
+
+/**
+ * @brief Resize the buffer if it's too small to handle the additional length.
+ * Otherwise do nothing. The first time that the inline storage is outgrown, 
+ * the contents are moved to the heap.
+ * 
+ * @param buf 
+ * @param len 
+ */
+static inline void resize_buffer(Buffer* buf, size_t len) {
+
+    if((buf->length + len) >= buf->capacity) {
+        STAT_INC(buffer_grows);
+        set_capacity(buf, next_capacity(buf, buf->length + len + 1));
+    }
+}
+
+/**
+ * @brief Close the gap, if there is one, so that the contents are in one 
+ * piece and terminated.
+ * 
+ * @param buf 
+ */
+static inline void close_gap(Buffer* buf) {
+
+    if(buf->gap_len > 0) {
+        memmove(&buf->buffer[buf->gap_pos], &buf->buffer[buf->gap_pos + buf->gap_len], 
+                buf->length - buf->gap_pos);
+        STAT_ADD(bytes_copied, buf->length - buf->gap_pos);
+        buf->gap_pos = buf->length;
+        buf->gap_len = 0;
+        buf->buffer[buf->length] = '\0';
+    }
+}
+
+/**
+ * @brief Insert into a buffer in gap mode. The gap is moved to the index, 
+ * which only moves the bytes between the old and the new position, and the 
+ * bytes are copied into it. When the gap is too small the buffer grows and 
+ * all of the free space becomes the gap.
+ * 
+ * @param buf 
+ * @param bytes 
+ * @param len 
+ * @param idx 
+ */
+static void insert_gap(Buffer* buf, const void* bytes, size_t len, size_t idx) {
+
+    if(len == 0)
+        return;
+
+    if(buf->gap_len < len) {
+        close_gap(buf);
+        resize_buffer(buf, len);
+        buf->gap_pos = buf->length;
+        buf->gap_len = buf->capacity - buf->length - 1;
+    }
+
+    if(idx < buf->gap_pos)
+        memmove(&buf->buffer[idx + buf->gap_len], &buf->buffer[idx], buf->gap_pos - idx);
+    else if(idx > buf->gap_pos)
+        memmove(&buf->buffer[buf->gap_pos], &buf->buffer[buf->gap_pos + buf->gap_len], 
+                idx - buf->gap_pos);
+    STAT_ADD(bytes_copied, (idx < buf->gap_pos)? buf->gap_pos - idx: idx - buf->gap_pos);
+
+    memcpy(&buf->buffer[idx], bytes, len);
+    STAT_ADD(bytes_copied, len);
+    buf->gap_pos = idx + len;
+    buf->gap_len -= len;
+    buf->length += len;
+
+    // keep the terminator after the last byte, wherever that is
+    buf->buffer[buf->length + buf->gap_len] = '\0';
+}
+
+/**
+ * @brief Unmap the file that a view refers to, once the view no longer 
+ * needs it.
+ * 
+ * @param buf 
+ */
+static inline void release_map(Buffer* buf) {
+
+    if(buf->map != NULL) {
+        munmap(buf->map, buf->map_len);
+        buf->map = NULL;
+        buf->map_len = 0;
+    }
+}
+
+/**
+ * @brief Make room for len more bytes at the end of the buffer and return 
+ * where they go. They are added with commit_spare().
+ * 
+ * @param buf 
+ * @param len 
+ * @return unsigned char* 
+ */
+static inline unsigned char* spare_buffer(Buffer* buf, size_t len) {
+
+    own_buffer(buf);
+    close_gap(buf);
+    resize_buffer(buf, len);
+
+    return &buf->buffer[buf->length];
+}
+
+/**
+ * @brief Add the len bytes that were written at the end of the buffer.
+ * 
+ * @param buf 
+ * @param len 
+ */
+static inline void commit_spare(Buffer* buf, size_t len) {
+
+    STAT_ADD(bytes_copied, len);
+    buf->length += len;
+    buf->buffer[buf->length] = '\0';
+}
+
+/**
+ * @brief Write the decimal digits of val backwards, ending at end, two at 
+ * a time. Returns where the digits start.
+ * 
+ * @param end 
+ * @param val 
+ * @return char* 
+ */
+static inline char* put_decimal(char* end, unsigned long long val) {
+
+    static const char pairs[] = 
+        "00010203040506070809101112131415161718192021222324"
+        "25262728293031323334353637383940414243444546474849"
+        "50515253545556575859606162636465666768697071727374"
+        "75767778798081828384858687888990919293949596979899";
+
+    while(val >= 100) {
+        unsigned idx = (val % 100) * 2;
+        val /= 100;
+        *--end = pairs[idx + 1];
+        *--end = pairs[idx];
+    }
+
+    if(val >= 10) {
+        *--end = pairs[val * 2 + 1];
+        *--end = pairs[val * 2];
+    }
+    else
+        *--end = '0' + val;
+
+    return end;
+}
+
+/**
+ * @brief Return an empty buffer header, from the pool if there is one.
+ * 
+ * @return Buffer* 
+ */
+static Buffer* alloc_header() {
+
+    Buffer* ptr = pool.headers;
+    if(ptr != NULL) {
+        pool.headers = (Buffer*)ptr->buffer;
+        pool.nheaders--;
+        STAT_INC(pool_hits);
+    }
+    else
+        ptr = _ALLOC_DS(Buffer);
+
+    ptr->length = 0;
+    ptr->capacity = BUFFER_INLINE_SIZE;
+    ptr->buffer = ptr->local;
+    ptr->local[0] = '\0';
+    ptr->growth = GROW_DOUBLE;
+    ptr->chunk = 0;
+    ptr->gap_mode = 0;
+    ptr->gap_pos = 0;
+    ptr->gap_len = 0;
+    ptr->map = NULL;
+    ptr->map_len = 0;
+
+    return ptr;
+}
+
+/*******************************************************************************
+ * Public Interface
+ */
+
+/**
+ * @brief Create a buffer object. Allocate the memory for a memory buffer and 
+ * initialize the data structure. Short contents are kept in the structure, 
+ * so they take a single allocation.
+ * 
+ * @param bytes 
+ * @param length 
+ * @return Buffer* 
+ */
+Buffer* create_buffer(void* bytes, size_t length) {
+
+    Buffer* ptr = alloc_header();
+
+    if(bytes != NULL)
+        append_buffer(ptr, bytes, length);
+
+    return ptr;
+}
+
+/**
+ * @brief Create a buffer that refers to bytes that it does not own. They 
+ * are not copied and must stay valid while the buffer is in use. The first 
+ * change to the buffer copies them into storage that it owns. The bytes do 
+ * not need to be NUL terminated.
+ * 
+ * @param bytes 
+ * @param length 
+ * @return Buffer* 
+ */
+Buffer* view_buffer(const void* bytes, size_t length) {
+
+    Buffer* ptr = alloc_header();
+    ptr->buffer = (unsigned char*)bytes;
+    ptr->length = length;
+    ptr->capacity = 0;
+
+    return ptr;
+}
+
+/**
+ * @brief If the buffer is a view, copy the bytes into storage that it owns. 
+ * This is done by every routine that changes the buffer.
+ * 
+ * @param buf 
+ */
+void own_buffer(Buffer* buf) {
+
+    ASSERT(buf != NULL);
+
+    if(buf->capacity != 0)
+        return;
+
+    const unsigned char* src = buf->buffer;
+    size_t cap = buf->length + 1;
+    if(cap <= BUFFER_INLINE_SIZE) {
+        buf->buffer = buf->local;
+        cap = BUFFER_INLINE_SIZE;
+    }
+    else
+        buf->buffer = take_store(&cap);
+
+    memcpy(buf->buffer, src, buf->length);
+    STAT_ADD(bytes_copied, buf->length);
+    buf->buffer[buf->length] = '\0';
+    buf->capacity = cap;
+    release_map(buf);
+}
+
+/**
+ * @brief Create an empty buffer that can hold size bytes without growing. 
+ * Use this when the final length is known.
+ * 
+ * @param size 
+ * @return Buffer* 
+ */
+Buffer* create_buffer_size(size_t size) {
+
+    Buffer* ptr = create_buffer(NULL, 0);
+    if(size >= ptr->capacity)
+        set_capacity(ptr, size + 1);
+
+    return ptr;
+}
+
+/**
+ * @brief Make sure that the buffer can hold size bytes in total without 
+ * growing. Small capacities are rounded up to the size class of the pool.
+ * 
+ * @param buf 
+ * @param size 
+ */
+void reserve_buffer(Buffer* buf, size_t size) {
+
+    ASSERT(buf != NULL);
+
+    own_buffer(buf);
+    close_gap(buf);
+    if(size >= buf->capacity)
+        set_capacity(buf, size + 1);
+}
+
+/**
+ * @brief Release the capacity that is not used by the contents. Contents 
+ * that are short enough are moved back into the structure.
+ * 
+ * @param buf 
+ */
+void shrink_buffer(Buffer* buf) {
+
+    ASSERT(buf != NULL);
+
+    own_buffer(buf);
+    close_gap(buf);
+    if(buf->length + 1 < buf->capacity)
+        set_capacity(buf, buf->length + 1);
+}
+
+/**
+ * @brief Select how the buffer grows when it is full. GROW_DOUBLE doubles 
+ * the capacity, GROW_HALF adds half of it and GROW_CHUNK adds multiples of 
+ * chunk bytes.
+ * 
+ * @param buf 
+ * @param growth 
+ * @param chunk 
+ */
+void set_buffer_growth(Buffer* buf, BufferGrowth growth, size_t chunk) {
+
+    ASSERT(buf != NULL);
+    ASSERT(growth != GROW_CHUNK || chunk > 0);
+
+    buf->growth = growth;
+    buf->chunk = chunk;
+}
+
+/**
+ * @brief Turn gap mode on or off. In gap mode, an insert leaves a gap after 
+ * the inserted bytes instead of moving the rest of the buffer, so a run of 
+ * inserts at or near the same place costs about the same as appending. The 
+ * gap is closed when the contents are needed in one piece.
+ * 
+ * @param buf 
+ * @param on 
+ */
+void set_buffer_gap(Buffer* buf, int on) {
+
+    ASSERT(buf != NULL);
+
+    if(!on)
+        close_gap(buf);
+    buf->gap_mode = on;
+}
+
+/**
+ * @brief Make sure that the contents are in one piece, so that the buffer 
+ * field can be read directly. The routines in this module do it when they 
+ * need to. This is only needed when reading the fields of a buffer that is 
+ * in gap mode.
+ * 
+ * @param buf 
+ */
+void flatten_buffer(Buffer* buf) {
+
+    ASSERT(buf != NULL);
+    close_gap(buf);
+}
+
+/**
+ * @brief Free memory that is associated with the buffer and that is managed 
+ * by the routines in this module.
+ * 
+ * @param buf 
+ */
+void destroy_buffer(Buffer* buf) {
+
+    if(buf != NULL) {
+        if(buf->buffer != NULL && buf->buffer != buf->local && buf->capacity != 0)
+            give_store(buf->buffer, buf->capacity);
+        release_map(buf);
+
+        if(pool.nheaders < POOL_DEPTH) {
+            watch_pool();
+            buf->buffer = (unsigned char*)pool.headers;
+            pool.headers = buf;
+            pool.nheaders++;
+        }
+        else
+            _FREE(buf);
+    }
+}
+
+/**
+ * @brief Free the buffers that the calling thread has kept for reuse. This 
+ * is done when the thread exits, so it is only needed to release the memory 
+ * earlier.
+ * 
+ */
+void drain_buffer_pool() {
+
+    pool_watched = 0;
+
+    while(pool.headers != NULL) {
+        Buffer* next = (Buffer*)pool.headers->buffer;
+        _FREE(pool.headers);
+        pool.headers = next;
+    }
+    pool.nheaders = 0;
+
+    for(int k = 0; k < POOL_CLASSES; k++) {
+        while(pool.stores[k] != NULL) {
+            _pool_block_* next = pool.stores[k]->next;
+            _FREE(pool.stores[k]);
+            pool.stores[k] = next;
+        }
+        pool.nstores[k] = 0;
+    }
+}
+
+/**
+ * @brief Add the bytes to the end of the buffer. Resize the buffer as needed.
+ * 
+ * @param buf 
+ * @param bytes 
+ * @param length 
+ */
+void append_buffer(Buffer* buf, void* bytes, size_t length) {
+
+    ASSERT(buf != NULL);
+
+    own_buffer(buf);
+    if(buf->gap_mode) {
+        insert_gap(buf, bytes, length, buf->length);
+        return;
+    }
+
+    resize_buffer(buf, length);
+    memcpy(&buf->buffer[buf->length], bytes, length);
+    STAT_ADD(bytes_copied, length);
+    buf->length += length;
+    buf->buffer[buf->length] = '\0';
+}
+
+/**
+ * @brief Insert the bytes at the beginning of the buffer.
+ * 
+ * @param buf 
+ * @param bytes 
+ * @param length 
+ */
+void prepend_buffer(Buffer* buf, void* bytes, size_t length) {
+
+    ASSERT(buf != NULL);
+
+    insert_buffer(buf, bytes, length, 0);
+}
+
+/**
+ * @brief Append formatted text. It is written straight into the free space 
+ * at the end of the buffer, and only formatted a second time if it did not 
+ * fit there. Because of that, neither the format nor any of the arguments 
+ * may point into the buffer itself. Use append_string_fmt() when they might.
+ * 
+ * @param buf 
+ * @param fmt 
+ * @param args 
+ */
+void format_buffer(Buffer* buf, const char* fmt, va_list args) {
+
+    ASSERT(buf != NULL);
+    ASSERT(fmt != NULL);
+
+    va_list copy;
+
+    unsigned char* dst = spare_buffer(buf, 0);
+    size_t room = buf->capacity - buf->length;
+    va_copy(copy, args);
+    int len = vsnprintf((char*)dst, room, fmt, copy);
+    va_end(copy);
+
+    if(len < 0) {
+        buf->buffer[buf->length] = '\0';
+        return;
+    }
+
+    if((size_t)len >= room) {
+        dst = spare_buffer(buf, len);
+        vsnprintf((char*)dst, len + 1, fmt, args);
+    }
+
+    commit_spare(buf, len);
+}
+
+/**
+ * @brief Append count copies of the byte.
+ * 
+ * @param buf 
+ * @param ch 
+ * @param count 
+ */
+void fill_buffer(Buffer* buf, int ch, size_t count) {
+
+    ASSERT(buf != NULL);
+
+    memset(spare_buffer(buf, count), ch, count);
+    commit_spare(buf, count);
+}
+
+/**
+ * @brief Append the value in decimal, with leading zeros to make at least 
+ * digits digits.
+ * 
+ * @param buf 
+ * @param val 
+ * @param digits 
+ */
+void append_int_buffer(Buffer* buf, long long val, int digits) {
+
+    ASSERT(buf != NULL);
+
+    char tmp[24];
+    char* end = &tmp[sizeof(tmp)];
+    unsigned long long mag = (val < 0)? 0ULL - (unsigned long long)val: (unsigned long long)val;
+    char* ptr = put_decimal(end, mag);
+
+    int ndig = end - ptr;
+    int npad = (digits > ndig)? digits - ndig: 0;
+    size_t len = (val < 0) + npad + ndig;
+
+    unsigned char* dst = spare_buffer(buf, len);
+    if(val < 0)
+        *dst++ = '-';
+    memset(dst, '0', npad);
+    memcpy(dst + npad, ptr, ndig);
+    commit_spare(buf, len);
+}
+
+/**
+ * @brief Append the value in lower case hex, with leading zeros to make at 
+ * least digits digits.
+ * 
+ * @param buf 
+ * @param val 
+ * @param digits 
+ */
+void append_hex_buffer(Buffer* buf, unsigned long long val, int digits) {
+
+    ASSERT(buf != NULL);
+
+    static const char hex[] = "0123456789abcdef";
+    char tmp[16];
+    int ndig = 0;
+
+    do {
+        tmp[15 - ndig++] = hex[val & 0xF];
+        val >>= 4;
+    } while(val != 0);
+
+    int npad = (digits > ndig)? digits - ndig: 0;
+    unsigned char* dst = spare_buffer(buf, npad + ndig);
+    memset(dst, '0', npad);
+    memcpy(dst + npad, &tmp[16 - ndig], ndig);
+    commit_spare(buf, npad + ndig);
+}
+
+/**
+ * @brief Append the shortest decimal form of the value that reads back as 
+ * the same double. Most values need 15 significant digits or fewer and 
+ * none need more than 17.
+ * 
+ * @param buf 
+ * @param val 
+ */
+void append_double_buffer(Buffer* buf, double val) {
+
+    ASSERT(buf != NULL);
+
+    // sign, 17 digits, point and an exponent fit with room to spare
+    char* dst = (char*)spare_buffer(buf, 32);
+    int len = 0;
+
+    for(int prec = 15; prec <= 17; prec++) {
+        len = snprintf(dst, 32, "%.*g", prec, val);
+        if(val != val || strtod(dst, NULL) == val)
+            break;
+    }
+
+    commit_spare(buf, len);
+}
+
+/**
+ * @brief Reset the data in the buffer but do not resize it.
+ * 
+ * @param buf 
+ */
+void clear_buffer(Buffer* buf) {
+
+    ASSERT(buf != NULL);
+
+    if(buf->capacity == 0) {
+        // nothing to copy, just stop referring to the bytes
+        buf->buffer = buf->local;
+        buf->capacity = BUFFER_INLINE_SIZE;
+        release_map(buf);
+    }
+
+    buf->length = 0;
+    buf->gap_pos = 0;
+    buf->gap_len = 0;
+    buf->buffer[0] = '\0';
+}
+
+/**
+ * @brief Remove len bytes from the front of the buffer without returning 
+ * them. A view only moves its start, so nothing is copied. This is how a 
+ * streaming reader drops what it has used.
  * 
  * @param buf 
  * @param len 
  */
-static inline void resize_buffer(Buffer* buf, size_t len) {
+void discard_buffer(Buffer* buf, size_t len) {
 
-    if((buf->length + len) >= buf->capacity) {
-        while((buf->length + len) >= buf->capacity)
-            buf->capacity <<= 1;
-        buf->buffer = _REALLOC_DS_ARRAY(buf->buffer, unsigned char, buf->capacity);
+    ASSERT(buf != NULL);
+
+    close_gap(buf);
+    if(len > buf->length)
+        len = buf->length;
+
+    if(buf->capacity == 0)
+        buf->buffer += len;
+    else {
+        memmove(buf->buffer, &buf->buffer[len], buf->length - len + 1);
+        STAT_ADD(bytes_copied, buf->length - len);
     }
+    buf->length -= len;
 }
 
-/*******************************************************************************
- * Public Interface
+/**
+ * @brief Return a copy of the data that is currently in the buffer. The 
+ * pointer returned should be free()d when it is no longer in use.
+ * 
+ * @param buf 
+ * @return void* 
  */
+void* raw_buffer(Buffer* buf) {
+
+    ASSERT(buf != NULL);
+    close_gap(buf);
+    return (void*)_COPY(buf->buffer, buf->length);
+}
 
 /**
- * @brief Create a buffer object. Allocate the memory for a memory buffer and 
- * initialize the data structure.
+ * @brief Return a pointer to the bytes in the buffer and store the length 
+ * in len. Nothing is copied. The pointer is good until the buffer is 
+ * changed or destroyed.
  * 
- * @param bytes 
- * @param length 
- * @return Buffer* 
+ * @param buf 
+ * @param len 
+ * @return const void* 
  */
-Buffer* create_buffer(void* bytes, size_t length) {
-
-    Buffer* ptr = _ALLOC_DS(Buffer);
-    ptr->length = 0;
-    ptr->capacity = 0x01 << 3;
-    ptr->buffer = _ALLOC_DS_ARRAY(unsigned char, ptr->capacity);
+const void* borrow_buffer(Buffer* buf, size_t* len) {
 
-    if(bytes != NULL)
-        append_buffer(ptr, bytes, length);
+    ASSERT(buf != NULL);
+    close_gap(buf);
 
-    return ptr;
+    *len = buf->length;
+    return buf->buffer;
 }
 
 /**
- * @brief Free memory that is associated with the buffer and that is managed 
- * by the routines in this module.
+ * @brief Fill in one iovec for each of the buffers, so they can be given 
+ * to writev() without being copied.
  * 
- * @param buf 
+ * @param bufs 
+ * @param count 
+ * @param iov 
  */
-void destroy_buffer(Buffer* buf) {
+void iovec_buffers(Buffer** bufs, int count, struct iovec* iov) {
 
-    if(buf != NULL) {
-        if(buf->buffer != NULL)
-            _FREE(buf->buffer);
-        _FREE(buf);
+    for(int i = 0; i < count; i++) {
+        close_gap(bufs[i]);
+        iov[i].iov_base = bufs[i]->buffer;
+        iov[i].iov_len = bufs[i]->length;
     }
 }
 
 /**
- * @brief Add the bytes to the end of the buffer. Resize the buffer as needed.
+ * @brief Write the buffers to the fd, one after the other, with as few 
+ * writev() calls as possible. Partial writes and interrupted calls are 
+ * continued. Returns 0 on success or -1 if a write failed.
  * 
- * @param buf 
- * @param bytes 
- * @param length 
+ * @param fd 
+ * @param bufs 
+ * @param count 
+ * @return int 
  */
-void append_buffer(Buffer* buf, void* bytes, size_t length) {
-
-    ASSERT(buf != NULL);
+int write_buffers_fd(int fd, Buffer** bufs, int count) {
+
+    struct iovec iov[WRITE_IOV];
+    int idx = 0;        // first buffer that is not completely written
+    size_t off = 0;     // bytes of it that have been written
+
+    for(int i = 0; i < count; i++)
+        close_gap(bufs[i]);
+
+    while(idx < count) {
+        int n = 0;
+        for(int i = idx; i < count && n < WRITE_IOV; i++) {
+            size_t skip = (i == idx)? off: 0;
+            if(bufs[i]->length > skip) {
+                iov[n].iov_base = bufs[i]->buffer + skip;
+                iov[n].iov_len = bufs[i]->length - skip;
+                n++;
+            }
+        }
+        if(n == 0)
+            break;
+
+        ssize_t w = writev(fd, iov, n);
+        if(w < 0 && errno == EINTR)
+            continue;
+        else if(w <= 0)
+            return -1;
+
+        size_t left = w;
+        while(idx < count && left >= bufs[idx]->length - off) {
+            left -= bufs[idx]->length - off;
+            off = 0;
+            idx++;
+        }
+        off += left;
+    }
 
-    resize_buffer(buf, length);
-    memcpy(&buf->buffer[buf->length], bytes, length);
-    buf->length += length;
-    buf->buffer[buf->length] = '\0';
+    return 0;
 }
 
 /**
- * @brief Insert the bytes at the beginning of the buffer.
+ * @brief Write the buffer to the fd. Partial writes and interrupted calls 
+ * are continued. Returns 0 on success or -1 if a write failed.
  * 
+ * @param fd 
  * @param buf 
- * @param bytes 
- * @param length 
+ * @return int 
  */
-void prepend_buffer(Buffer* buf, void* bytes, size_t length) {
+int write_buffer_fd(int fd, Buffer* buf) {
 
-    ASSERT(buf != NULL);
-
-    insert_buffer(buf, bytes, length, 0);
+    return write_buffers_fd(fd, &buf, 1);
 }
 
 /**
- * @brief Reset the data in the buffer but do not resize it.
+ * @brief Read up to chunk bytes from the fd straight into the end of the 
+ * buffer. If there is less than half of that free, the buffer grows first. 
+ * Returns the number of bytes read, 0 at the end of the input, or -1 on an 
+ * error. A streaming reader calls this to refill the buffer and 
+ * discard_buffer() to drop what it has used.
  * 
  * @param buf 
+ * @param fd 
+ * @param chunk 
+ * @return ssize_t 
  */
-void clear_buffer(Buffer* buf) {
+ssize_t read_buffer_fd(Buffer* buf, int fd, size_t chunk) {
 
     ASSERT(buf != NULL);
-    buf->length = 0;
-    memset(buf->buffer, 0, buf->capacity);
+    ASSERT(chunk > 0);
+
+    own_buffer(buf);
+    close_gap(buf);
+
+    // use the free space if there is a fair amount of it, else make room
+    size_t room = buf->capacity - buf->length - 1;
+    if(room < (chunk + 1) / 2) {
+        resize_buffer(buf, chunk);
+        room = buf->capacity - buf->length - 1;
+    }
+    if(room > chunk)
+        room = chunk;
+
+    ssize_t n;
+    do
+        n = read(fd, &buf->buffer[buf->length], room);
+    while(n < 0 && errno == EINTR);
+
+    if(n > 0) {
+        buf->length += n;
+        buf->buffer[buf->length] = '\0';
+    }
+
+    return n;
 }
 
 /**
- * @brief Return a copy of the data that is currently in the buffer. The 
- * pointer returned should be free()d when it is no longer in use.
+ * @brief Load a whole file into a new buffer. Large regular files are 
+ * mapped and the buffer is a view of the mapping, so nothing is copied 
+ * unless the buffer is changed. Other files are read into a buffer of the 
+ * right size. Returns NULL and leaves errno set if the file cannot be read.
  * 
- * @param buf 
- * @return void* 
+ * @param name 
+ * @return Buffer* 
  */
-void* raw_buffer(Buffer* buf) {
+Buffer* load_buffer_file(const char* name) {
 
-    ASSERT(buf != NULL);
-    return (void*)_COPY(buf->buffer, buf->length);
+    int fd = open(name, O_RDONLY);
+    if(fd < 0)
+        return NULL;
+
+    struct stat st;
+    if(fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+
+    Buffer* buf = NULL;
+    if(S_ISREG(st.st_mode) && st.st_size >= MAP_THRESHOLD) {
+        void* ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(ptr != MAP_FAILED) {
+            buf = view_buffer(ptr, st.st_size);
+            buf->map = ptr;
+            buf->map_len = st.st_size;
+        }
+    }
+
+    if(buf == NULL) {
+        // read one byte past the size, to see the end in one call
+        size_t chunk = S_ISREG(st.st_mode)? (size_t)st.st_size + 1: MAP_THRESHOLD;
+        buf = create_buffer_size(chunk);
+
+        // a short read of a regular file is most likely the end, so check 
+        // that without making room for another chunk
+        ssize_t n;
+        while((n = read_buffer_fd(buf, fd, chunk)) > 0)
+            chunk = (S_ISREG(st.st_mode) && (size_t)n < chunk)? 1: MAP_THRESHOLD;
+
+        if(n < 0) {
+            int err = errno;
+            destroy_buffer(buf);
+            close(fd);
+            errno = err;
+            return NULL;
+        }
+    }
+
+    close(fd);
+    return buf;
 }
 
 /**
@@ -165,7 +1119,8 @@ int iterate_buffer(Buffer* buf, int* post) {
     int retv;
 
     if(*post >= 0 && *post < (int)buf->length) {
-        retv = buf->buffer[*post];
+        size_t idx = *post;
+        retv = buf->buffer[(idx < buf->gap_pos)? idx: idx + buf->gap_len];
         *post = *post + 1;
     }
     else
@@ -190,11 +1145,15 @@ void insert_buffer(Buffer* buf, void* bytes, size_t len, int index) {
     ASSERT(buf != NULL);
     ASSERT(bytes != NULL);
 
+    own_buffer(buf);
     int idx = normalize_index(buf, index);
-    if(idx >= 0) {
+    if(idx >= 0 && buf->gap_mode)
+        insert_gap(buf, bytes, len, idx);
+    else if(idx >= 0) {
         resize_buffer(buf, len);
-        memmove(&buf->buffer[idx+len], &buf->buffer[idx], buf->length-idx);
+        memmove(&buf->buffer[idx+len], &buf->buffer[idx], buf->length-idx+1);
         memcpy(&buf->buffer[idx], bytes, len);
+        STAT_ADD(bytes_copied, buf->length - idx + len);
         buf->length += len;
     }
     else
@@ -215,12 +1174,17 @@ void replace_buffer(Buffer* buf, void* bytes, size_t len, int index) {
     ASSERT(buf != NULL);
     ASSERT(bytes != NULL);
 
+    own_buffer(buf);
+    close_gap(buf);
     int idx = normalize_index(buf, index);
     if(idx >= 0) {
         resize_buffer(buf, (idx + len) - buf->length);
         memcpy(&buf->buffer[idx], bytes, len);
-        if((idx + len) > buf->length)
+        STAT_ADD(bytes_copied, len);
+        if((idx + len) > buf->length) {
             buf->length += (idx + len) - buf->length;
+            buf->buffer[buf->length] = '\0';
+        }
     }
     else
         append_buffer(buf, bytes, len);
@@ -245,17 +1209,216 @@ void* clip_buffer(Buffer* buf, int start, int end) {
     if(si >= ei)
         return NULL;
 
+    close_gap(buf);
     int len = ei - si;
     char* tmp = _ALLOC(len+1);
     memcpy(tmp, &buf->buffer[si], len);
     tmp[len] = '\0';
-    memmove(&buf->buffer[si], &buf->buffer[ei], buf->length-len);
+
+    // a view can lose either end without being copied
+    if(buf->capacity == 0 && (si == 0 || ei == (int)buf->length)) {
+        if(si == 0)
+            buf->buffer += ei;
+        buf->length -= len;
+        return (void*)tmp;
+    }
+
+    own_buffer(buf);
+    memmove(&buf->buffer[si], &buf->buffer[ei], buf->length-ei);
+    STAT_ADD(bytes_copied, buf->length - si);
     buf->length -= len;
     buf->buffer[buf->length] = '\0';
 
     return (void*)tmp;
 }
 
+/**
+ * @brief Replace the bytes from the start index to the end index with the 
+ * new bytes. The tail of the buffer is moved once. If the indexes are out of 
+ * bounds or reversed then nothing is done.
+ * 
+ * @param buf 
+ * @param start 
+ * @param end 
+ * @param bytes 
+ * @param len 
+ */
+void splice_buffer(Buffer* buf, int start, int end, void* bytes, size_t len) {
+
+    ASSERT(buf != NULL);
+    ASSERT(bytes != NULL || len == 0);
+
+    int si = normalize_index(buf, start);
+    int ei = normalize_index(buf, end);
+    if(si < 0 || ei < si)
+        return;
+
+    own_buffer(buf);
+    close_gap(buf);
+    size_t del = ei - si;
+    if(len > del)
+        resize_buffer(buf, len - del);
+
+    if(len != del) {
+        memmove(&buf->buffer[si + len], &buf->buffer[ei], buf->length - ei + 1);
+        STAT_ADD(bytes_copied, buf->length - ei);
+    }
+    memcpy(&buf->buffer[si], bytes, len);
+    STAT_ADD(bytes_copied, len);
+    buf->length = buf->length - del + len;
+}
+
+/**
+ * @brief Find the next match of any of the patterns at or after pos. With 
+ * more than one pattern, the earliest match wins and of the patterns that 
+ * match there, the longest one wins. Returns the index, or -1.
+ * 
+ * @param ctx 
+ * @param hay 
+ * @param n 
+ * @param pos 
+ * @param which 
+ * @return long 
+ */
+static long next_subst(const _subst_t_* ctx, const unsigned char* hay, size_t n, 
+                       size_t pos, int* which) {
+
+    if(ctx->count == 1) {
+        const BufferSubst* sub = ctx->subs;
+        const unsigned char* ptr = find_bytes(&hay[pos], n - pos, sub->find, sub->find_len);
+        *which = 0;
+        return (ptr != NULL)? (long)(ptr - hay): -1;
+    }
+
+    while(pos < n) {
+        if(ctx->lead >= 0) {
+            const unsigned char* ptr = memchr(&hay[pos], ctx->lead, n - pos);
+            if(ptr == NULL)
+                return -1;
+            pos = ptr - hay;
+        }
+        else if(!ctx->first[hay[pos]]) {
+            pos++;
+            continue;
+        }
+
+        int best = -1;
+        for(int i = 0; i < ctx->count; i++) {
+            const BufferSubst* sub = &ctx->subs[i];
+            if(sub->find_len <= n - pos && 
+                    (best < 0 || sub->find_len > ctx->subs[best].find_len) && 
+                    !memcmp(&hay[pos], sub->find, sub->find_len))
+                best = i;
+        }
+
+        if(best >= 0) {
+            *which = best;
+            return (long)pos;
+        }
+        pos++;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Replace every match of the patterns, scanning from left to right 
+ * without overlapping. The result is built in a single pass over the 
+ * contents. When no replacement is longer than its pattern that is done in 
+ * place, otherwise a first pass finds the final length so that the result 
+ * goes into storage of the right size, which is the only allocation. 
+ * Returns the number of replacements.
+ * 
+ * @param buf 
+ * @param subs 
+ * @param count 
+ * @return int 
+ */
+int substitute_buffer(Buffer* buf, const BufferSubst* subs, int count) {
+
+    ASSERT(buf != NULL);
+    ASSERT(subs != NULL);
+
+    _subst_t_ ctx;
+    ctx.subs = subs;
+    ctx.count = count;
+    ctx.lead = -1;
+    memset(ctx.first, 0, sizeof(ctx.first));
+
+    int grows = 0;
+    for(int i = 0; i < count; i++) {
+        ASSERT(subs[i].find_len > 0);
+        int ch = *(const unsigned char*)subs[i].find;
+        ctx.lead = (i == 0 || ctx.lead == ch)? ch: -2;
+        ctx.first[ch] = 1;
+        if(subs[i].repl_len > subs[i].find_len)
+            grows = 1;
+    }
+    if(ctx.lead < 0)
+        ctx.lead = -1;
+
+    close_gap(buf);
+    const unsigned char* src = buf->buffer;
+    size_t n = buf->length;
+    size_t total = n;
+    int matches = 0;
+    int which;
+    long idx;
+
+    if(grows || buf->capacity == 0) {
+        for(idx = next_subst(&ctx, src, n, 0, &which); idx >= 0; 
+                idx = next_subst(&ctx, src, n, idx + subs[which].find_len, &which)) {
+            total = total - subs[which].find_len + subs[which].repl_len;
+            matches++;
+        }
+        if(matches == 0)
+            return 0;
+    }
+
+    // in place, the output never gets ahead of the input
+    unsigned char small[BUFFER_INLINE_SIZE];
+    unsigned char* dst = buf->buffer;
+    size_t cap = total + 1;
+    if(grows || buf->capacity == 0)
+        dst = (cap <= BUFFER_INLINE_SIZE)? small: take_store(&cap);
+
+    size_t out = 0;
+    size_t pos = 0;
+    matches = 0;
+    while((idx = next_subst(&ctx, src, n, pos, &which)) >= 0) {
+        const BufferSubst* sub = &subs[which];
+        if(dst != src || out != pos)
+            memmove(&dst[out], &src[pos], idx - pos);
+        out += idx - pos;
+        memcpy(&dst[out], sub->repl, sub->repl_len);
+        out += sub->repl_len;
+        pos = idx + sub->find_len;
+        matches++;
+    }
+    if(dst != src || out != pos)
+        memmove(&dst[out], &src[pos], n - pos);
+    out += n - pos;
+    dst[out] = '\0';
+    STAT_ADD(bytes_copied, out);
+
+    if(dst != buf->buffer) {
+        if(buf->capacity != 0 && buf->buffer != buf->local)
+            give_store(buf->buffer, buf->capacity);
+        release_map(buf);
+
+        if(dst == small) {
+            memcpy(buf->local, small, out + 1);
+            dst = buf->local;
+            cap = BUFFER_INLINE_SIZE;
+        }
+        buf->buffer = dst;
+        buf->capacity = cap;
+    }
+    buf->length = out;
+
+    return matches;
+}
+
 /**
  * @brief Return the index of the first byte that matches the sequence given. 
  * If there is no match then return (<0).
@@ -267,21 +1430,142 @@ void* clip_buffer(Buffer* buf, int start, int end) {
  */
 int search_buffer(Buffer* buf, void* bytes, size_t len) {
 
-    int retv = -1;
+    ASSERT(buf != NULL);
+    close_gap(buf);
 
-    if(buf->length >= len) {
-        int run = buf->length - len;
-        for(int i = 0; i <= run; i++) {
-            if(!memcmp(&buf->buffer[i], bytes, len)) {
-                retv = i;
-                break;
-            }
-        }
+    const unsigned char* ptr = find_bytes(buf->buffer, buf->length, bytes, len);
+    return (ptr != NULL)? (int)(ptr - buf->buffer): -1;
+}
+
+/**
+ * @brief Return the index of the last byte sequence that matches the one 
+ * given. If there is no match then return (<0).
+ * 
+ * @param buf 
+ * @param bytes 
+ * @param len 
+ * @return int 
+ */
+int rsearch_buffer(Buffer* buf, void* bytes, size_t len) {
+
+    ASSERT(buf != NULL);
+    close_gap(buf);
+
+    const unsigned char* ptr = rfind_bytes(buf->buffer, buf->length, bytes, len);
+    return (ptr != NULL)? (int)(ptr - buf->buffer): -1;
+}
+
+/**
+ * @brief Return the index of each match in turn. The matches do not 
+ * overlap. On the first call, post must point to 0. When (*post == -1) 
+ * then there are no more matches and (<0) is returned.
+ * 
+ * @param buf 
+ * @param bytes 
+ * @param len 
+ * @param post 
+ * @return int 
+ */
+int search_all_buffer(Buffer* buf, void* bytes, size_t len, int* post) {
+
+    ASSERT(buf != NULL);
+    close_gap(buf);
+
+    if(*post < 0 || len == 0 || (size_t)*post > buf->length) {
+        *post = -1;
+        return -1;
+    }
+
+    const unsigned char* ptr = find_bytes(&buf->buffer[*post], buf->length - *post, bytes, len);
+    if(ptr == NULL) {
+        *post = -1;
+        return -1;
     }
 
+    int retv = (int)(ptr - buf->buffer);
+    *post = retv + len;
     return retv;
 }
 
+/**
+ * @brief Return the number of times that the bytes occur in the buffer 
+ * without overlapping.
+ * 
+ * @param buf 
+ * @param bytes 
+ * @param len 
+ * @return int 
+ */
+int count_buffer(Buffer* buf, void* bytes, size_t len) {
+
+    int count = 0;
+    int post = 0;
+
+    while(search_all_buffer(buf, bytes, len, &post) >= 0)
+        count++;
+
+    return count;
+}
+
+/**
+ * @brief Return the index of the first byte at or after start that is in 
+ * the set. If there is none then return (<0).
+ * 
+ * @param buf 
+ * @param set 
+ * @param start 
+ * @return int 
+ */
+int find_set_buffer(Buffer* buf, const ByteSet* set, int start) {
+
+    ASSERT(buf != NULL);
+    close_gap(buf);
+
+    int si = normalize_index(buf, start);
+    if(si < 0)
+        return -1;
+
+    size_t idx = si + find_byte_set(&buf->buffer[si], buf->length - si, set);
+    return (idx < buf->length)? (int)idx: -1;
+}
+
+/**
+ * @brief Return the index of the first byte at or after start that is not 
+ * in the set. If they all are then return (<0).
+ * 
+ * @param buf 
+ * @param set 
+ * @param start 
+ * @return int 
+ */
+int skip_set_buffer(Buffer* buf, const ByteSet* set, int start) {
+
+    ASSERT(buf != NULL);
+    close_gap(buf);
+
+    int si = normalize_index(buf, start);
+    if(si < 0)
+        return -1;
+
+    size_t idx = si + skip_byte_set(&buf->buffer[si], buf->length - si, set);
+    return (idx < buf->length)? (int)idx: -1;
+}
+
+/**
+ * @brief Return the number of bytes in the buffer that are in the set.
+ * 
+ * @param buf 
+ * @param set 
+ * @return int 
+ */
+int count_set_buffer(Buffer* buf, const ByteSet* set) {
+
+    ASSERT(buf != NULL);
+    close_gap(buf);
+
+    return (int)count_byte_set(buf->buffer, buf->length, set);
+}
+
 /**
  * @brief Return the result of memcmp() as a raw byte compare on the two 
  * buffers. If the buffers are not the same size then not a match.
@@ -292,6 +1576,9 @@ int search_buffer(Buffer* buf, void* bytes, size_t len) {
  */
 int comp_buffer(Buffer* left, Buffer* right) {
 
+    close_gap(left);
+    close_gap(right);
+
     if(left->length != right->length)
         return left->length - right->length; // no zero, no match
     else
@@ -327,6 +1614,7 @@ static void dump_buffer(Buffer* buf, const char* msg, ...) {
  */
 int main() {
 
+    int post;
     char* str = "this is the test string";
     Buffer* buf = create_buffer((void*)str, strlen(str));
     dump_buffer(buf, "after create");
@@ -385,6 +1673,18 @@ int main() {
     printf("\nsearch for '%s' returned %d\nshould be -1\n", str,
            search_buffer(buf, (void*)str, strlen(str)));
 
+    str = "st";
+    printf("\nreverse search for '%s' returned %d\nshould be 35\n", str,
+           rsearch_buffer(buf, (void*)str, strlen(str)));
+    printf("\ncount of '%s' returned %d\nshould be 3\n", str,
+           count_buffer(buf, (void*)str, strlen(str)));
+
+    post = 0;
+    printf("\nall of '%s':", str);
+    while(search_all_buffer(buf, (void*)str, strlen(str), &post) >= 0)
+        printf(" %d", post - (int)strlen(str));
+    printf("\nshould be 25 32 35\n");
+
     dump_buffer(buf, "dump buffer");
 
     str = "brown";
@@ -407,7 +1707,85 @@ int main() {
     str1 = (char*)clip_buffer(buf, 0, -1);
     dump_buffer(buf, "clipped '%s' from 0 to -1", str1);
 
+    str = "the quick brown fox jumps over the lazy dog";
+    destroy_buffer(buf);
+    buf = create_buffer_size(strlen(str));
+    dump_buffer(buf, "create with room for %lu", strlen(str));
+    append_buffer(buf, (void*)str, strlen(str));
+    dump_buffer(buf, "append without growing");
+
+    set_buffer_growth(buf, GROW_CHUNK, 100);
+    append_buffer(buf, (void*)str, strlen(str));
+    dump_buffer(buf, "grow by a chunk of 100");
+
+    reserve_buffer(buf, 1000);
+    dump_buffer(buf, "reserve 1000");
+
+    _FREE(clip_buffer(buf, 10, -1));
+    shrink_buffer(buf);
+    dump_buffer(buf, "clip to 10 and shrink, now inline");
+
+    destroy_buffer(buf);
+    buf = create_buffer(NULL, 0);
+    set_buffer_gap(buf, 1);
+    for(int i = 0; i < 5; i++) {
+        char tmp[16];
+        snprintf(tmp, sizeof(tmp), "%d ", i);
+        prepend_buffer(buf, (void*)tmp, strlen(tmp));
+        insert_buffer(buf, (void*)"x", 1, 1);
+    }
+    printf("\ngap mode, gap of %lu at %lu\n", buf->gap_len, buf->gap_pos);
+    flatten_buffer(buf);
+    dump_buffer(buf, "flattened, should be '4x 3x 2x 1x 0x '");
+
+    // clip and shrink move the contents out from under the gap
+    clear_buffer(buf);
+    char big[200];
+    memset(big, 'g', sizeof(big));
+    insert_buffer(buf, (void*)big, sizeof(big), 0);
+    _FREE(clip_buffer(buf, 0, 195));
+    shrink_buffer(buf);
+    insert_buffer(buf, (void*)big, 0, 0);
+    insert_buffer(buf, (void*)"ab", 2, 2);
+    _FREE(clip_buffer(buf, 1, 3));
+    insert_buffer(buf, (void*)"", 0, 1);
+    prepend_buffer(buf, (void*)"<", 1);
+    append_buffer(buf, (void*)">", 1);
+    shrink_buffer(buf);
+    insert_buffer(buf, (void*)"", 0, -1);
+    flatten_buffer(buf);
+    dump_buffer(buf, "gap mode with clip and shrink, should be '<gbggg>'");
+
+    destroy_buffer(buf);
+    buf = create_buffer((void*)"a {x} and a {y} and {x}{x}", 26);
+    splice_buffer(buf, 0, 1, (void*)"one", 3);
+    dump_buffer(buf, "splice 'one' over 0 to 1");
+    BufferSubst subs[] = {
+        { "{x}", 3, "1", 1 },
+        { "{y}", 3, "twenty-two", 10 },
+    };
+    printf("\n%d replaced\n", substitute_buffer(buf, subs, 2));
+    dump_buffer(buf, "substitute {x} and {y}");
+
+    clear_buffer(buf);
+    append_int_buffer(buf, -1234567, 0);
+    fill_buffer(buf, ' ', 2);
+    append_int_buffer(buf, 42, 5);
+    fill_buffer(buf, ' ', 2);
+    append_hex_buffer(buf, 0xbeef, 8);
+    fill_buffer(buf, ' ', 2);
+    append_double_buffer(buf, 0.1);
+    dump_buffer(buf, "int, padded int, hex and double");
+
+    destroy_buffer(buf);
+    buf = load_buffer_file(__FILE__);
+    printf("\nloaded %s: %lu bytes, %d lines\n", __FILE__, buf->length,
+           count_buffer(buf, (void*)"\n", 1));
+    discard_buffer(buf, rsearch_buffer(buf, (void*)"#endif", 6));
+    dump_buffer(buf, "discard all but the last line");
+
     printf("\ndestroy buffer\n");
+    destroy_buffer(buf);
     printf("finished\n");
     return 0;
 }
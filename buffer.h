@@ -13,24 +13,82 @@
 #define _BUFFER_H_
 
 #include <stdlib.h>
+#include <stdarg.h>
+#include <sys/uio.h>
+
+#include "bytes.h"
+
+// Contents shorter than this are stored in the Buffer itself.
+#define BUFFER_INLINE_SIZE 24
+
+typedef enum {
+    GROW_DOUBLE,    // double the capacity, the default
+    GROW_HALF,      // add half of the capacity
+    GROW_CHUNK,     // add a fixed number of bytes
+} BufferGrowth;
 
 typedef struct {
     unsigned char* buffer;  // raw array of bytes.
-    size_t capacity;    // number of bytes the buffer can hold
+    size_t capacity;    // number of bytes the buffer can hold, 0 for a view
     size_t length;      // number of bytes currently in the buffer
+    BufferGrowth growth;
+    size_t chunk;       // bytes added by GROW_CHUNK
+    int gap_mode;       // inserts open a gap instead of moving the tail
+    size_t gap_pos;     // where the gap starts
+    size_t gap_len;     // bytes in the gap, 0 when the contents are flat
+    void* map;          // file mapping that a view refers to, if any
+    size_t map_len;
+    unsigned char local[BUFFER_INLINE_SIZE];    // used until the first grow
 } Buffer;
 
+// One pattern and its replacement for substitute_buffer().
+typedef struct {
+    const void* find;
+    size_t find_len;    // must not be 0
+    const void* repl;
+    size_t repl_len;
+} BufferSubst;
+
 Buffer* create_buffer(void* bytes, size_t length);
+Buffer* create_buffer_size(size_t size);
+Buffer* view_buffer(const void* bytes, size_t length);
+void own_buffer(Buffer* buf);
+void reserve_buffer(Buffer* buf, size_t size);
+void shrink_buffer(Buffer* buf);
+void set_buffer_growth(Buffer* buf, BufferGrowth growth, size_t chunk);
+void set_buffer_gap(Buffer* buf, int on);
+void flatten_buffer(Buffer* buf);
 void destroy_buffer(Buffer* buf);
+void drain_buffer_pool();
 void append_buffer(Buffer* buf, void* bytes, size_t length);
 void prepend_buffer(Buffer* buf, void* bytes, size_t length);
+void format_buffer(Buffer* buf, const char* fmt, va_list args);
+void fill_buffer(Buffer* buf, int ch, size_t count);
+void append_int_buffer(Buffer* buf, long long val, int digits);
+void append_hex_buffer(Buffer* buf, unsigned long long val, int digits);
+void append_double_buffer(Buffer* buf, double val);
 void insert_buffer(Buffer* buf, void* bytes, size_t len, int index);
 void replace_buffer(Buffer* buf, void* bytes, size_t len, int index);
 void* clip_buffer(Buffer* buf, int start, int end);
+void splice_buffer(Buffer* buf, int start, int end, void* bytes, size_t len);
+int substitute_buffer(Buffer* buf, const BufferSubst* subs, int count);
 int search_buffer(Buffer* buf, void* bytes, size_t len);
+int rsearch_buffer(Buffer* buf, void* bytes, size_t len);
+int search_all_buffer(Buffer* buf, void* bytes, size_t len, int* post);
+int count_buffer(Buffer* buf, void* bytes, size_t len);
+int find_set_buffer(Buffer* buf, const ByteSet* set, int start);
+int skip_set_buffer(Buffer* buf, const ByteSet* set, int start);
+int count_set_buffer(Buffer* buf, const ByteSet* set);
 int comp_buffer(Buffer* left, Buffer* right);
 int iterate_buffer(Buffer* buf, int* post);
 void clear_buffer(Buffer* buf);
+void discard_buffer(Buffer* buf, size_t len);
 void* raw_buffer(Buffer* buf);
+const void* borrow_buffer(Buffer* buf, size_t* len);
+void iovec_buffers(Buffer** bufs, int count, struct iovec* iov);
+int write_buffers_fd(int fd, Buffer** bufs, int count);
+int write_buffer_fd(int fd, Buffer* buf);
+ssize_t read_buffer_fd(Buffer* buf, int fd, size_t chunk);
+Buffer* load_buffer_file(const char* name);
 
 #endif  /* _BUFFER_H_ */
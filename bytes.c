@@ -0,0 +1,869 @@
+/**
+ * @file bytes.c
+ *
+ * @brief Substring search over raw bytes. Needles of up to SHORT_NEEDLE
+ * bytes are found by testing the first and the last byte of the needle at
+ * every position, 16 positions at a time with SSE2 where it is available,
+ * and comparing the rest only where both match. Longer needles use the
+ * Two-Way algorithm of Crochemore and Perrin, which runs in linear time
+ * with constant space, so inputs such as "aaaa...ab" cannot make it
+ * quadratic. The reverse search runs the same code on the mirrored input.
+ *
+ * Byte sets are kept as a table for the scalar code and, when they are
+ * made of a few ranges, as the ranges too. SSE2 has no table lookup, so the
+ * vector code tests 16 bytes against each range with one subtract and one
+ * unsigned compare. None of this depends on the locale.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-22
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <string.h>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "bytes.h"
+
+#define SHORT_NEEDLE 32
+
+// bytes that a set scan tests one at a time before it uses vectors
+#define SCAN_LEAD 16
+
+// index into p[0..len) from the front, or from the back when rev is set
+#define AT(p, len, i) (rev? (p)[(len) - 1 - (i)]: (p)[i])
+
+/**
+ * @brief Split the needle at a critical position and return the position.
+ * The period of the right half is stored in period. This is the maximal
+ * suffix computation, done for both orderings of the alphabet, keeping the
+ * longer of the two suffixes.
+ *
+ * @param needle
+ * @param m
+ * @param period
+ * @param rev
+ * @return size_t
+ */
+static inline size_t critical_factorization(const unsigned char* needle, size_t m,
+                                            size_t* period, int rev) {
+
+    size_t ms, ms_rev, j, k, p;
+    unsigned char a, b;
+
+    // maximal suffix for the normal order
+    ms = SIZE_MAX;
+    j = 0;
+    k = p = 1;
+    while(j + k < m) {
+        a = AT(needle, m, j + k);
+        b = AT(needle, m, ms + k);
+        if(a < b) {
+            j += k;
+            k = 1;
+            p = j - ms;
+        }
+        else if(a == b) {
+            if(k != p)
+                k++;
+            else {
+                j += p;
+                k = 1;
+            }
+        }
+        else {
+            ms = j++;
+            k = p = 1;
+        }
+    }
+    *period = p;
+
+    // maximal suffix for the reversed order
+    ms_rev = SIZE_MAX;
+    j = 0;
+    k = p = 1;
+    while(j + k < m) {
+        a = AT(needle, m, j + k);
+        b = AT(needle, m, ms_rev + k);
+        if(b < a) {
+            j += k;
+            k = 1;
+            p = j - ms_rev;
+        }
+        else if(a == b) {
+            if(k != p)
+                k++;
+            else {
+                j += p;
+                k = 1;
+            }
+        }
+        else {
+            ms_rev = j++;
+            k = p = 1;
+        }
+    }
+
+    // SIZE_MAX stands for -1, so compare the positions plus one
+    if(ms_rev + 1 < ms + 1)
+        return ms + 1;
+
+    *period = p;
+    return ms_rev + 1;
+}
+
+/**
+ * @brief Two-Way search. Returns the offset of the first match in the
+ * haystack, counted from the back if rev is set, or SIZE_MAX.
+ *
+ * @param hay
+ * @param n
+ * @param needle
+ * @param m
+ * @param rev
+ * @return size_t
+ */
+static inline size_t two_way(const unsigned char* hay, size_t n,
+                             const unsigned char* needle, size_t m, int rev) {
+
+    size_t period;
+    size_t suffix = critical_factorization(needle, m, &period, rev);
+    size_t i, j;
+
+    // the needle is periodic if the left half repeats at the period
+    int periodic = 1;
+    for(i = 0; i < suffix && periodic; i++)
+        periodic = (AT(needle, m, i) == AT(needle, m, i + period));
+
+    if(periodic) {
+        // remember how much of the left half is known to match after a
+        // shift by the period, so no byte is compared twice
+        size_t memory = 0;
+        j = 0;
+        while(j <= n - m) {
+            i = (suffix > memory)? suffix: memory;
+            while(i < m && AT(needle, m, i) == AT(hay, n, i + j))
+                i++;
+            if(i >= m) {
+                i = suffix - 1;
+                while(memory < i + 1 && AT(needle, m, i) == AT(hay, n, i + j))
+                    i--;
+                if(i + 1 < memory + 1)
+                    return j;
+                j += period;
+                memory = m - period;
+            }
+            else {
+                j += i - suffix + 1;
+                memory = 0;
+            }
+        }
+    }
+    else {
+        period = ((suffix > m - suffix)? suffix: m - suffix) + 1;
+        j = 0;
+        while(j <= n - m) {
+            i = suffix;
+            while(i < m && AT(needle, m, i) == AT(hay, n, i + j))
+                i++;
+            if(i >= m) {
+                i = suffix - 1;
+                while(i != SIZE_MAX && AT(needle, m, i) == AT(hay, n, i + j))
+                    i--;
+                if(i == SIZE_MAX)
+                    return j;
+                j += period;
+            }
+            else
+                j += i - suffix + 1;
+        }
+    }
+
+    return SIZE_MAX;
+}
+
+/**
+ * @brief Search for a needle of 2 to SHORT_NEEDLE bytes by the first and
+ * last bytes. The rest of the needle is only compared at the positions
+ * where both of them match.
+ *
+ * @param hay
+ * @param n
+ * @param needle
+ * @param m
+ * @return const unsigned char*
+ */
+static const unsigned char* find_short(const unsigned char* hay, size_t n,
+                                       const unsigned char* needle, size_t m) {
+
+    const unsigned char first = needle[0];
+    const unsigned char last = needle[m - 1];
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128i vfirst = _mm_set1_epi8((char)first);
+    const __m128i vlast = _mm_set1_epi8((char)last);
+
+    // the second load reads 16 bytes from i + m - 1
+    for(; i + m + 15 <= n; i += 16) {
+        __m128i bf = _mm_loadu_si128((const __m128i*)(hay + i));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(hay + i + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf, vfirst),
+                                                        _mm_cmpeq_epi8(bl, vlast)));
+        while(mask != 0) {
+            size_t pos = i + __builtin_ctz(mask);
+            if(!memcmp(hay + pos + 1, needle + 1, m - 2))
+                return hay + pos;
+            mask &= mask - 1;
+        }
+    }
+#endif
+
+    for(; i + m <= n; i++) {
+        if(hay[i] == first && hay[i + m - 1] == last &&
+                !memcmp(hay + i + 1, needle + 1, m - 2))
+            return hay + i;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief The same as find_short(), but finds the last match.
+ *
+ * @param hay
+ * @param n
+ * @param needle
+ * @param m
+ * @return const unsigned char*
+ */
+static const unsigned char* rfind_short(const unsigned char* hay, size_t n,
+                                        const unsigned char* needle, size_t m) {
+
+    const unsigned char first = needle[0];
+    const unsigned char last = needle[m - 1];
+    size_t i = n - m + 1;   // one past the last possible start
+
+#ifdef __SSE2__
+    const __m128i vfirst = _mm_set1_epi8((char)first);
+    const __m128i vlast = _mm_set1_epi8((char)last);
+
+    // test the 16 starts just below i
+    for(; i >= 16; i -= 16) {
+        size_t base = i - 16;
+        __m128i bf = _mm_loadu_si128((const __m128i*)(hay + base));
+        __m128i bl = _mm_loadu_si128((const __m128i*)(hay + base + m - 1));
+        unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(bf, vfirst),
+                                                        _mm_cmpeq_epi8(bl, vlast)));
+        while(mask != 0) {
+            int bit = 31 - __builtin_clz(mask);
+            size_t pos = base + bit;
+            if(!memcmp(hay + pos + 1, needle + 1, m - 2))
+                return hay + pos;
+            mask &= ~(1u << bit);
+        }
+    }
+#endif
+
+    while(i-- > 0) {
+        if(hay[i] == first && hay[i + m - 1] == last &&
+                !memcmp(hay + i + 1, needle + 1, m - 2))
+            return hay + i;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Find the ranges of the set, or of its complement if that has
+ * fewer, for the vector code. If neither fits then the table is used.
+ *
+ * @param set
+ */
+static void set_ranges(ByteSet* set) {
+
+    for(int invert = 0; invert < 2; invert++) {
+        int count = 0;
+        for(int ch = 0; ch < 256; ch++) {
+            if((set->table[ch] != 0) == invert)
+                continue;
+            if(count > 0 && set->hi[count - 1] == ch - 1)
+                set->hi[count - 1] = ch;
+            else if(count < BYTE_SET_RANGES) {
+                set->lo[count] = set->hi[count] = ch;
+                count++;
+            }
+            else {
+                count = -1;
+                break;
+            }
+        }
+
+        if(count >= 0) {
+            set->nranges = count;
+            set->invert = invert;
+            return;
+        }
+    }
+
+    set->nranges = -1;
+    set->invert = 0;
+}
+
+#ifdef __SSE2__
+// the ranges of a set, loaded into registers once for a whole scan
+typedef struct {
+    __m128i lo[BYTE_SET_RANGES];
+    __m128i width[BYTE_SET_RANGES];
+    int nranges;
+    unsigned flip;
+} _vector_set_t_;
+
+/**
+ * @brief Load the ranges of the set. The mask of matches is flipped if the
+ * ranges are of the complement or if the bytes not in the set are wanted.
+ *
+ * @param vs
+ * @param set
+ * @param want
+ */
+static inline void load_set(_vector_set_t_* vs, const ByteSet* set, int want) {
+
+    vs->nranges = set->nranges;
+    vs->flip = (set->invert != !want)? 0xFFFF: 0;
+    for(int r = 0; r < set->nranges; r++) {
+        vs->lo[r] = _mm_set1_epi8((char)set->lo[r]);
+        vs->width[r] = _mm_set1_epi8((char)(set->hi[r] - set->lo[r]));
+    }
+}
+
+/**
+ * @brief Return a mask with a bit set for each of the 16 bytes that is
+ * wanted.
+ *
+ * @param vs
+ * @param v
+ * @return unsigned
+ */
+static inline unsigned set_mask(const _vector_set_t_* vs, __m128i v) {
+
+    __m128i acc = _mm_setzero_si128();
+
+    // v - lo <= hi - lo, unsigned, is the same as lo <= v <= hi
+    for(int r = 0; r < vs->nranges; r++) {
+        __m128i d = _mm_sub_epi8(v, vs->lo[r]);
+        acc = _mm_or_si128(acc, _mm_cmpeq_epi8(_mm_max_epu8(d, vs->width[r]), vs->width[r]));
+    }
+
+    return _mm_movemask_epi8(acc) ^ vs->flip;
+}
+
+/**
+ * @brief Return 0x20 in each byte that is a letter from first to first+25
+ * and 0 in the others.
+ *
+ * @param v
+ * @param first
+ * @return __m128i
+ */
+static inline __m128i case_mask(__m128i v, char first) {
+
+    __m128i d = _mm_sub_epi8(v, _mm_set1_epi8(first));
+    __m128i w = _mm_set1_epi8(25);
+    __m128i letter = _mm_cmpeq_epi8(_mm_max_epu8(d, w), w);
+    return _mm_and_si128(letter, _mm_set1_epi8(0x20));
+}
+#endif
+
+/**
+ * @brief Return the index of the first byte that is in the set if want is
+ * set, or that is not in the set if it is not. Returns n if there is none.
+ *
+ * @param ptr
+ * @param n
+ * @param set
+ * @param want
+ * @return size_t
+ */
+static inline size_t scan_set(const unsigned char* ptr, size_t n,
+                              const ByteSet* set, int want) {
+
+    size_t i = 0;
+
+    // most runs are short, so look at the first few bytes before paying to
+    // load the ranges into registers
+    size_t lead = (n < SCAN_LEAD)? n: SCAN_LEAD;
+    for(; i < lead; i++)
+        if(!set->table[ptr[i]] == !want)
+            return i;
+
+#ifdef __SSE2__
+    if(set->nranges >= 0 && i < n) {
+        _vector_set_t_ vs;
+        load_set(&vs, set, want);
+        for(; i + 16 <= n; i += 16) {
+            unsigned mask = set_mask(&vs, _mm_loadu_si128((const __m128i*)(ptr + i)));
+            if(mask != 0)
+                return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for(; i < n; i++)
+        if(!set->table[ptr[i]] == !want)
+            return i;
+
+    return n;
+}
+
+/******************************************************************************
+ *
+ * Internal Interface
+ *
+ */
+
+/**
+ * @brief Return a pointer to the first place that the needle occurs in the
+ * haystack, or NULL if it does not. An empty needle matches at the start.
+ *
+ * @param hay
+ * @param n
+ * @param needle
+ * @param m
+ * @return const unsigned char*
+ */
+const unsigned char* find_bytes(const unsigned char* hay, size_t n,
+                                const unsigned char* needle, size_t m) {
+
+    if(m == 0)
+        return hay;
+    if(m > n)
+        return NULL;
+    if(m == 1)
+        return memchr(hay, needle[0], n);
+    if(m <= SHORT_NEEDLE)
+        return find_short(hay, n, needle, m);
+
+    size_t pos = two_way(hay, n, needle, m, 0);
+    return (pos != SIZE_MAX)? hay + pos: NULL;
+}
+
+/**
+ * @brief Return a pointer to the last place that the needle occurs in the
+ * haystack, or NULL if it does not. An empty needle matches at the end.
+ *
+ * @param hay
+ * @param n
+ * @param needle
+ * @param m
+ * @return const unsigned char*
+ */
+const unsigned char* rfind_bytes(const unsigned char* hay, size_t n,
+                                 const unsigned char* needle, size_t m) {
+
+    if(m == 0)
+        return hay + n;
+    if(m > n)
+        return NULL;
+    if(m == 1) {
+        for(size_t i = n; i-- > 0;)
+            if(hay[i] == needle[0])
+                return hay + i;
+        return NULL;
+    }
+    if(m <= SHORT_NEEDLE)
+        return rfind_short(hay, n, needle, m);
+
+    // the offset is of the first match in the mirrored haystack
+    size_t pos = two_way(hay, n, needle, m, 1);
+    return (pos != SIZE_MAX)? hay + (n - pos - m): NULL;
+}
+
+/**
+ * @brief Make the set empty.
+ *
+ * @param set
+ */
+void init_byte_set(ByteSet* set) {
+
+    memset(set->table, 0, sizeof(set->table));
+    set_ranges(set);
+}
+
+/**
+ * @brief Add the bytes from lo to hi, inclusive, to the set.
+ *
+ * @param set
+ * @param lo
+ * @param hi
+ */
+void add_byte_set(ByteSet* set, int lo, int hi) {
+
+    for(int ch = lo; ch <= hi; ch++)
+        set->table[ch & 0xFF] = 1;
+    set_ranges(set);
+}
+
+/**
+ * @brief Make the set hold exactly the n bytes given.
+ *
+ * @param set
+ * @param bytes
+ * @param n
+ */
+void fill_byte_set(ByteSet* set, const unsigned char* bytes, size_t n) {
+
+    memset(set->table, 0, sizeof(set->table));
+    for(size_t i = 0; i < n; i++)
+        set->table[bytes[i]] = 1;
+    set_ranges(set);
+}
+
+/**
+ * @brief Remove the bytes from lo to hi, inclusive, from the set.
+ *
+ * @param set
+ * @param lo
+ * @param hi
+ */
+void remove_byte_set(ByteSet* set, int lo, int hi) {
+
+    for(int ch = lo; ch <= hi; ch++)
+        set->table[ch & 0xFF] = 0;
+    set_ranges(set);
+}
+
+/**
+ * @brief Return the index of the first byte that is in the set, or n if
+ * there is none.
+ *
+ * @param ptr
+ * @param n
+ * @param set
+ * @return size_t
+ */
+size_t find_byte_set(const unsigned char* ptr, size_t n, const ByteSet* set) {
+
+    return scan_set(ptr, n, set, 1);
+}
+
+/**
+ * @brief Return the index of the first byte that is not in the set, or n if
+ * they all are. This is the length of the run of bytes in the set.
+ *
+ * @param ptr
+ * @param n
+ * @param set
+ * @return size_t
+ */
+size_t skip_byte_set(const unsigned char* ptr, size_t n, const ByteSet* set) {
+
+    return scan_set(ptr, n, set, 0);
+}
+
+/**
+ * @brief Return the number of bytes that are in the set.
+ *
+ * @param ptr
+ * @param n
+ * @param set
+ * @return size_t
+ */
+size_t count_byte_set(const unsigned char* ptr, size_t n, const ByteSet* set) {
+
+    size_t count = 0;
+    size_t i = 0;
+
+#ifdef __SSE2__
+    if(set->nranges >= 0) {
+        _vector_set_t_ vs;
+        load_set(&vs, set, 1);
+        for(; i + 16 <= n; i += 16)
+            count += __builtin_popcount(set_mask(&vs, _mm_loadu_si128((const __m128i*)(ptr + i))));
+    }
+#endif
+
+    for(; i < n; i++)
+        count += (set->table[ptr[i]] != 0);
+
+    return count;
+}
+
+/**
+ * @brief Return nonzero if every byte is in the set.
+ *
+ * @param ptr
+ * @param n
+ * @param set
+ * @return int
+ */
+int check_byte_set(const unsigned char* ptr, size_t n, const ByteSet* set) {
+
+    return scan_set(ptr, n, set, 0) == n;
+}
+
+/**
+ * @brief Convert the ASCII letters to lower case. Other bytes are not
+ * changed, whatever the locale.
+ *
+ * @param ptr
+ * @param n
+ */
+void lower_bytes(unsigned char* ptr, size_t n) {
+
+    size_t i = 0;
+
+#ifdef __SSE2__
+    for(; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(ptr + i));
+        _mm_storeu_si128((__m128i*)(ptr + i), _mm_or_si128(v, case_mask(v, 'A')));
+    }
+#endif
+
+    for(; i < n; i++)
+        if(ptr[i] >= 'A' && ptr[i] <= 'Z')
+            ptr[i] |= 0x20;
+}
+
+/**
+ * @brief Convert the ASCII letters to upper case. Other bytes are not
+ * changed, whatever the locale.
+ *
+ * @param ptr
+ * @param n
+ */
+void upper_bytes(unsigned char* ptr, size_t n) {
+
+    size_t i = 0;
+
+#ifdef __SSE2__
+    for(; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(ptr + i));
+        _mm_storeu_si128((__m128i*)(ptr + i), _mm_xor_si128(v, case_mask(v, 'a')));
+    }
+#endif
+
+    for(; i < n; i++)
+        if(ptr[i] >= 'a' && ptr[i] <= 'z')
+            ptr[i] &= ~0x20;
+}
+
+/******************************************************************************
+ *
+ * Test Code
+ *
+ */
+#ifdef TEST_BYTES
+
+#include <stdio.h>
+#include <time.h>
+
+#include "memory.h"
+
+static const unsigned char* naive_find(const unsigned char* hay, size_t n,
+                                       const unsigned char* needle, size_t m) {
+
+    for(size_t i = 0; i + m <= n; i++)
+        if(!memcmp(hay + i, needle, m))
+            return hay + i;
+    return (m == 0)? hay: NULL;
+}
+
+static const unsigned char* naive_rfind(const unsigned char* hay, size_t n,
+                                        const unsigned char* needle, size_t m) {
+
+    if(m > n)
+        return NULL;
+    for(size_t i = n - m + 1; i-- > 0;)
+        if(!memcmp(hay + i, needle, m))
+            return hay + i;
+    return NULL;
+}
+
+static double elapsed(struct timespec* start) {
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+int main() {
+
+    unsigned char hay[300], needle[80];
+    int failed = 0;
+
+    srand(4321);
+
+    // random inputs over small alphabets so that there are many near misses
+    for(int t = 0; t < 200000; t++) {
+        size_t n = rand() % 300;
+        size_t m = 1 + rand() % 79;
+        int alpha = 1 + rand() % 3;
+        for(size_t i = 0; i < n; i++)
+            hay[i] = 'a' + rand() % alpha;
+        for(size_t i = 0; i < m; i++)
+            needle[i] = 'a' + rand() % alpha;
+        // plant the needle some of the time
+        if(m <= n && (rand() & 1))
+            memcpy(hay + rand() % (n - m + 1), needle, m);
+
+        if(find_bytes(hay, n, needle, m) != naive_find(hay, n, needle, m) ||
+                rfind_bytes(hay, n, needle, m) != naive_rfind(hay, n, needle, m)) {
+            if(failed++ < 10)
+                printf("mismatch: n %lu m %lu\n", n, m);
+        }
+    }
+    printf("random inputs checked, %d mismatches\n", failed);
+
+    // worst cases: the needle is all but one byte of a long run
+    for(size_t n = 1 << 16; n <= (1 << 20); n <<= 2) {
+        size_t m = 1024;
+        unsigned char* h = _ALLOC(n);
+        unsigned char* nd = _ALLOC(m);
+        memset(h, 'a', n);
+        memset(nd, 'a', m);
+        nd[m - 1] = 'b';
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const unsigned char* r1 = find_bytes(h, n, nd, m);
+        const unsigned char* r2 = rfind_bytes(h, n, nd, m);
+        double fast = elapsed(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const unsigned char* r3 = naive_find(h, n, nd, m);
+        double slow = elapsed(&start);
+
+        printf("'a'x%lu in 'a'x%lu: two-way %.3f ms (both ways), memcmp scan %.3f ms\n",
+               m - 1, n, fast, slow);
+        if(r1 != NULL || r2 != NULL || r3 != NULL)
+            failed++;
+
+        _FREE(h);
+        _FREE(nd);
+    }
+
+    // short needle over a large buffer
+    {
+        size_t n = 1 << 24;
+        unsigned char* h = _ALLOC(n);
+        for(size_t i = 0; i < n; i++)
+            h[i] = 'a' + i % 23;
+        const unsigned char nd[] = "--output-file";
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const unsigned char* r = find_bytes(h, n, nd, sizeof(nd) - 1);
+        double fast = elapsed(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const unsigned char* r2 = naive_find(h, n, nd, sizeof(nd) - 1);
+        double slow = elapsed(&start);
+
+        printf("13 byte needle in %lu bytes: filter %.3f ms, memcmp scan %.3f ms\n", n, fast, slow);
+        if(r != NULL || r2 != NULL)
+            failed++;
+        _FREE(h);
+    }
+
+    // random byte sets, some with too many ranges for the vector code
+    int set_failed = 0;
+    for(int t = 0; t < 20000; t++) {
+        ByteSet set;
+        init_byte_set(&set);
+        int nadd = rand() % 12;
+        for(int i = 0; i < nadd; i++) {
+            int lo = rand() % 256;
+            int hi = lo + rand() % 40;
+            if(rand() % 3)
+                add_byte_set(&set, lo, (hi > 255)? 255: hi);
+            else
+                remove_byte_set(&set, lo, (hi > 255)? 255: hi);
+        }
+
+        size_t n = rand() % 300;
+        for(size_t i = 0; i < n; i++)
+            hay[i] = rand() % 256;
+
+        size_t find = n, skip = n, count = 0;
+        for(size_t i = 0; i < n; i++) {
+            if(set.table[hay[i]]) {
+                count++;
+                if(find == n)
+                    find = i;
+            }
+            else if(skip == n)
+                skip = i;
+        }
+
+        if(find_byte_set(hay, n, &set) != find || skip_byte_set(hay, n, &set) != skip ||
+                count_byte_set(hay, n, &set) != count ||
+                check_byte_set(hay, n, &set) != (skip == n)) {
+            if(set_failed++ < 10)
+                printf("byte set mismatch: n %lu ranges %d\n", n, set.nranges);
+        }
+
+        unsigned char lower[300], upper[300];
+        memcpy(lower, hay, n);
+        memcpy(upper, hay, n);
+        lower_bytes(lower, n);
+        upper_bytes(upper, n);
+        for(size_t i = 0; i < n; i++) {
+            int ch = hay[i];
+            if(lower[i] != ((ch >= 'A' && ch <= 'Z')? ch + 32: ch) ||
+                    upper[i] != ((ch >= 'a' && ch <= 'z')? ch - 32: ch)) {
+                if(set_failed++ < 10)
+                    printf("case mismatch: %02X\n", ch);
+                break;
+            }
+        }
+    }
+    printf("random byte sets checked, %d mismatches\n", set_failed);
+    failed += set_failed;
+
+    // the characters of an option argument, over a large buffer
+    {
+        size_t n = 1 << 24;
+        unsigned char* h = _ALLOC(n + 1);
+        for(size_t i = 0; i < n; i++)
+            h[i] = 'a' + i % 23;
+        h[n] = '\0';
+
+        ByteSet word;
+        init_byte_set(&word);
+        add_byte_set(&word, ' ', '~');
+        remove_byte_set(&word, '=', '=');
+        remove_byte_set(&word, ':', ':');
+        remove_byte_set(&word, ',', ',');
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        size_t r = skip_byte_set(h, n, &word);
+        double fast = elapsed(&start);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        size_t r2 = 0;
+        while(word.table[h[r2]])
+            r2++;
+        double slow = elapsed(&start);
+
+        printf("word of %lu bytes: %d ranges %.3f ms, table loop %.3f ms\n", n, word.nranges, fast, slow);
+        if(r != n || r2 != n)
+            failed++;
+        _FREE(h);
+    }
+
+    if(failed) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("finished\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,45 @@
+/**
+ * @file bytes.h
+ *
+ * @brief Internal interface for searching and scanning raw bytes.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-22
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef _BYTES_H_
+#define _BYTES_H_
+
+#include <stdlib.h>
+
+// Sets that are this many ranges of byte values or fewer, or whose
+// complement is, are tested 16 bytes at a time.
+#define BYTE_SET_RANGES 6
+
+typedef struct {
+    unsigned char table[256];   // nonzero for the bytes in the set
+    int nranges;                // -1 when the set has too many ranges
+    int invert;                 // the ranges are of the bytes not in the set
+    unsigned char lo[BYTE_SET_RANGES];
+    unsigned char hi[BYTE_SET_RANGES];
+} ByteSet;
+
+const unsigned char* find_bytes(const unsigned char* hay, size_t n,
+                                const unsigned char* needle, size_t m);
+const unsigned char* rfind_bytes(const unsigned char* hay, size_t n,
+                                 const unsigned char* needle, size_t m);
+
+void init_byte_set(ByteSet* set);
+void add_byte_set(ByteSet* set, int lo, int hi);
+void fill_byte_set(ByteSet* set, const unsigned char* bytes, size_t n);
+void remove_byte_set(ByteSet* set, int lo, int hi);
+size_t find_byte_set(const unsigned char* ptr, size_t n, const ByteSet* set);
+size_t skip_byte_set(const unsigned char* ptr, size_t n, const ByteSet* set);
+size_t count_byte_set(const unsigned char* ptr, size_t n, const ByteSet* set);
+int check_byte_set(const unsigned char* ptr, size_t n, const ByteSet* set);
+void lower_bytes(unsigned char* ptr, size_t n);
+void upper_bytes(unsigned char* ptr, size_t n);
+
+#endif  /* _BYTES_H_ */
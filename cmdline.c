@@ -17,6 +17,8 @@
 #include <ctype.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
 
 #include "ptr_lst.h"
 #include "memory.h"
@@ -24,6 +26,9 @@
 #include "cmdline.h"
 #include "parse.h"
 #include "errors.h"
+#include "complete.h"
+#include "stats.h"
+#include "trace.h"
 
 static _cmdline_t_* cmdline = NULL;
 
@@ -40,7 +45,9 @@ _cmd_opt_t_* search_short(int c) {
 
     int post = 0;
     _cmd_opt_t_* ptr;
+    STAT_INC(lookups);
     while(NULL != (ptr = iterate_ptr_lst(cmdline->cmd_opts, &post))) {
+        STAT_INC(lookup_scans);
         if(ptr->short_opt == c)
             return ptr;
     }
@@ -49,21 +56,52 @@ _cmd_opt_t_* search_short(int c) {
 }
 
 /**
- * @brief Search for a long option in the command list.
+ * @brief Return the trie of long names. It is built from the registered 
+ * options the first time it is needed after a registration.
+ * 
+ * @return Trie* 
+ */
+Trie* get_long_trie() {
+
+    if(cmdline->long_trie == NULL) {
+        cmdline->long_trie = create_trie();
+
+        int post = 0;
+        _cmd_opt_t_* ptr;
+        while(NULL != (ptr = iterate_ptr_lst(cmdline->cmd_opts, &post))) {
+            if(strlen(ptr->long_opt) > 0)
+                insert_trie(cmdline->long_trie, ptr->long_opt, ptr);
+        }
+    }
+
+    return cmdline->long_trie;
+}
+
+/**
+ * @brief Search for a long option in the command list. An exact match is 
+ * returned first. Otherwise, the option is returned if the given string is 
+ * an abbreviation of exactly one long name.
  * 
  * @param opt 
  * @return _cmd_opt_t_* 
  */
 _cmd_opt_t_* search_long(const char* opt) {
 
-    int post = 0;
-    _cmd_opt_t_* ptr;
-    while(NULL != (ptr = iterate_ptr_lst(cmdline->cmd_opts, &post))) {
-        if(!strcmp(ptr->long_opt, opt))
-            return ptr;
-    }
+    size_t len = strlen(opt);
+    if(len == 0)
+        return NULL;
 
-    return NULL;
+    STAT_INC(lookups);
+    STAT_ADD(lookup_scans, len);
+    TrieNode* node = prefix_trie(get_long_trie(), opt, len);
+    if(node == NULL)
+        return NULL;
+    else if(node->data != NULL)
+        return node->data;
+    else if(node->count == 1)
+        return node->only;
+    else
+        return NULL;
 }
 
 /**
@@ -76,7 +114,9 @@ _cmd_opt_t_* search_name(const char* name) {
 
     int post = 0;
     _cmd_opt_t_* ptr;
+    STAT_INC(lookups);
     while(NULL != (ptr = iterate_ptr_lst(cmdline->cmd_opts, &post))) {
+        STAT_INC(lookup_scans);
         if(!strcmp(ptr->name, name))
             return ptr;
     }
@@ -93,7 +133,9 @@ _cmd_opt_t_* search_no_name() {
 
     int post = 0;
     _cmd_opt_t_* ptr;
+    STAT_INC(lookups);
     while(NULL != (ptr = iterate_ptr_lst(cmdline->cmd_opts, &post))) {
+        STAT_INC(lookup_scans);
         if(ptr->short_opt == 0 && strlen(ptr->long_opt) == 0)
             return ptr;
     }
@@ -101,6 +143,100 @@ _cmd_opt_t_* search_no_name() {
     return NULL;
 }
 
+/**
+ * @brief Search for a subcommand by name.
+ * 
+ * @param name 
+ * @return _subcmd_t_* 
+ */
+_subcmd_t_* search_subcmd(const char* name) {
+
+    int post = 0;
+    _subcmd_t_* ptr;
+    STAT_INC(lookups);
+    while(NULL != (ptr = iterate_ptr_lst(cmdline->subcmds, &post))) {
+        STAT_INC(lookup_scans);
+        if(!strcmp(ptr->name, name))
+            return ptr;
+    }
+
+    return NULL;
+}
+
+/**
+ * @brief Make the subcommand the selected one and let it register its 
+ * options. The options that exist at this point are the global ones.
+ * 
+ * @param sub 
+ */
+void select_subcmd(_subcmd_t_* sub) {
+
+    cmdline->nglobal = cmdline->cmd_opts->len;
+    cmdline->subcmd = sub;
+    if(cmdline->help != NULL) {
+        destroy_string(cmdline->help);
+        cmdline->help = NULL;
+    }
+    if(sub->callback != NULL) {
+        uint64_t start = trace_begin();
+        (*sub->callback)();
+        trace_end("subcommand registration", start);
+    }
+}
+
+/**
+ * @brief Compare two options by name for qsort(). Ties are broken by the 
+ * position of the values, which follows the order of registration, so that 
+ * the search finds the same option that search_name() would.
+ * 
+ * @param left 
+ * @param right 
+ * @return int 
+ */
+static int comp_frozen_opt(const void* left, const void* right) {
+
+    const _frozen_opt_t_* l = (const _frozen_opt_t_*)left;
+    const _frozen_opt_t_* r = (const _frozen_opt_t_*)right;
+
+    int retv = strcmp(l->name, r->name);
+    if(retv == 0)
+        retv = l->first - r->first;
+    if(retv == 0)
+        retv = l->count - r->count;
+
+    return retv;
+}
+
+/**
+ * @brief Search for a name in the frozen registry. This performs no writes 
+ * of any kind, so it is safe to call from any number of threads.
+ * 
+ * @param name 
+ * @return const _frozen_opt_t_* 
+ */
+static const _frozen_opt_t_* search_frozen(const char* name) {
+
+    const _frozen_t_* fz = cmdline->frozen;
+    int lo = 0;
+    int hi = fz->nopts;
+
+    // lower bound, so that the first registered duplicate is found
+    STAT_INC(lookups);
+    while(lo < hi) {
+        STAT_INC(lookup_scans);
+        int mid = lo + ((hi - lo) >> 1);
+        if(strcmp(fz->opts[mid].name, name) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if(lo < fz->nopts && !strcmp(fz->opts[lo].name, name))
+        return &fz->opts[lo];
+
+    return NULL;
+}
+
 /******************************************************************************
  * 
  * Public Interface
@@ -130,6 +266,13 @@ void init_cmdline(const char* intro, const char* outtro,
     append_string_str(ptr->sopts, "-:");
     ptr->flag = 0;
     ptr->min_reqd = 0;
+    ptr->subcmds = create_ptr_lst();
+    ptr->subcmd = NULL;
+    ptr->nglobal = 0;
+    ptr->long_trie = NULL;
+    ptr->help = NULL;
+    ptr->frozen = NULL;
+    ptr->reg_start = trace_begin();
 
     cmdline = ptr;
 }
@@ -162,6 +305,8 @@ void uninit_cmdline() {
                     _FREE(ptr->help);
                 if(ptr->long_opt != NULL)
                     _FREE(ptr->long_opt);
+                if(ptr->def_val != NULL)
+                    _FREE(ptr->def_val);
                 if(ptr->values != NULL)
                     destroy_str_lst(ptr->values);
                 _FREE(ptr);
@@ -169,11 +314,31 @@ void uninit_cmdline() {
             destroy_ptr_lst(cmdline->cmd_opts);
         }
 
+        if(cmdline->subcmds != NULL) {
+            int post = 0;
+            _subcmd_t_* ptr;
+            while(NULL != (ptr = iterate_ptr_lst(cmdline->subcmds, &post))) {
+                _FREE(ptr->name);
+                _FREE(ptr->help);
+                _FREE(ptr);
+            }
+            destroy_ptr_lst(cmdline->subcmds);
+        }
+
         // note to self: order of these operations is important
         if(cmdline->sopts != NULL)
             destroy_string(cmdline->sopts);
+        if(cmdline->long_trie != NULL)
+            destroy_trie(cmdline->long_trie);
+        if(cmdline->help != NULL)
+            destroy_string(cmdline->help);
+        if(cmdline->frozen != NULL)
+            _FREE(cmdline->frozen);
         _FREE(cmdline);
+        cmdline = NULL;
     }
+
+    reset_diags();
 }
 
 /**
@@ -196,6 +361,7 @@ void add_cmdline(int short_opt, const char* long_opt,
                     CmdType flag) {
     
     ASSERT_MSG(cmdline != NULL, "init the cmdline data structure before calling this.");
+    ASSERT_MSG(cmdline->frozen == NULL, "cannot add options after freeze_cmdline().");
 
     if(flag & CMD_REQD)
         cmdline->min_reqd++;
@@ -209,10 +375,62 @@ void add_cmdline(int short_opt, const char* long_opt,
     ptr->values = create_str_lst();
     ptr->flag = flag;
     ptr->callback = cb;
-    if(value != NULL)
+    ptr->def_val = NULL;
+    if(value != NULL) {
+        ptr->def_val = _COPY_STR(value);
         append_str_lst(ptr->values, create_string(value));
+    }
 
     append_ptr_lst(cmdline->cmd_opts, ptr);
+
+    // the long name trie and the help text are rebuilt on demand
+    if(cmdline->long_trie != NULL) {
+        destroy_trie(cmdline->long_trie);
+        cmdline->long_trie = NULL;
+    }
+    if(cmdline->help != NULL) {
+        destroy_string(cmdline->help);
+        cmdline->help = NULL;
+    }
+}
+
+/**
+ * @brief Add a subcommand, such as "commit" in "git commit". Only the name is 
+ * stored here. The callback is called when, and only when, the subcommand is 
+ * selected on the command line and it should call add_cmdline() for the 
+ * options that belong to the subcommand. Options that were added before 
+ * parse_cmdline() are global and are accepted with every subcommand. The 
+ * subcommand is the first word on the command line that is not an option.
+ * 
+ * @param name 
+ * @param help 
+ * @param cb 
+ */
+void add_subcmd(const char* name, const char* help, cmdline_callback cb) {
+
+    ASSERT_MSG(cmdline != NULL, "init the cmdline data structure before calling this.");
+    ASSERT_MSG(name != NULL && strlen(name) > 0, "a subcommand must have a name.");
+
+    _subcmd_t_* ptr = _ALLOC_DS(_subcmd_t_);
+    ptr->name = _COPY_STR(name);
+    ptr->help = _COPY_STR(help);
+    ptr->callback = cb;
+
+    append_ptr_lst(cmdline->subcmds, ptr);
+}
+
+/**
+ * @brief Return the name of the subcommand that was selected on the command 
+ * line, or NULL if there was none.
+ * 
+ * @return const char* 
+ */
+const char* get_subcmd() {
+
+    if(cmdline->subcmd != NULL)
+        return cmdline->subcmd->name;
+    else
+        return NULL;
 }
 
 /**
@@ -231,29 +449,122 @@ void add_cmdline(int short_opt, const char* long_opt,
 void parse_cmdline(int argc, char** argv, int flag) {
 
     ASSERT_MSG(cmdline != NULL, "init the cmdline data structure before calling this.");
+    ASSERT_MSG(cmdline->frozen == NULL, "cannot parse after freeze_cmdline().");
+
+    trace_end("registration", cmdline->reg_start);
+    begin_diags();
 
     cmdline->prog = _COPY_STR(argv[0]);
     cmdline->flag = flag;
+    if(cmdline->help != NULL) {
+        destroy_string(cmdline->help);
+        cmdline->help = NULL;
+    }
+
+    // shell completion query: prog --complete cword word0 word1 ...
+    if(argc > 2 && !strcmp(argv[1], "--complete")) 
+        run_completion(atoi(argv[2]), argc - 3, &argv[3]);
 
     if(argc <= cmdline->min_reqd) 
-        error("at least %d command arguments are required.", cmdline->min_reqd);
+        diag(DIAG_ERROR, DIAG_MISSING, "at least %d command arguments are required.", cmdline->min_reqd);
+
+    uint64_t start = trace_begin();
+    get_long_trie();
+    trace_end("index", start);
 
+    start = trace_begin();
     internal_parse_cmdline(argc, argv);
+    trace_end("tokenization", start);
 
     // verify that all of the required options have a value
+    start = trace_begin();
     int post = 0;
     _cmd_opt_t_* op;
     while(NULL != (op = iterate_ptr_lst(cmdline->cmd_opts, &post))) {
         if((op->flag & CMD_REQD) && (!(op->flag & CMD_SEEN) || (op->values->len == 0))) {
             if(op->short_opt != 0)
-                error("required command parameter '-%c' missing.", op->short_opt);
+                diag(DIAG_ERROR, DIAG_MISSING, "required command parameter '-%c' missing.", op->short_opt);
             else if(strlen(op->long_opt) > 0)
-                error("required command parameter '--%s' missing.", op->long_opt);
+                diag(DIAG_ERROR, DIAG_MISSING, "required command parameter '--%s' missing.", op->long_opt);
             else 
-                error("required command parameter '%s' missing.", op->name);
+                diag(DIAG_ERROR, DIAG_MISSING, "required command parameter '%s' missing.", op->name);
+        }
+    }
+    trace_end("validation", start);
+
+    // warnings were collected while parsing
+    end_diags();
+}
+
+/**
+ * @brief Convert the registry into a read-only image after the command line 
+ * has been parsed. The names and values are copied into one contiguous block 
+ * and the options are sorted by name. After this returns, get_cmdline() and 
+ * iterate_cmdline() read only from that block and perform no writes at all, 
+ * so any number of threads may call them concurrently without locking. The 
+ * registry cannot be changed or parsed again once it has been frozen.
+ * 
+ */
+void freeze_cmdline() {
+
+    ASSERT_MSG(cmdline != NULL, "init the cmdline data structure before calling this.");
+
+    if(cmdline->frozen != NULL)
+        return;
+
+    // size everything first so that the block is allocated exactly once
+    int nopts = cmdline->cmd_opts->len;
+    int nvals = 0;
+    size_t nchars = 0;
+    int post = 0;
+    _cmd_opt_t_* ptr;
+
+    while(NULL != (ptr = iterate_ptr_lst(cmdline->cmd_opts, &post))) {
+        nchars += strlen(ptr->name) + 1;
+        for(size_t i = 0; i < ptr->values->len; i++) 
+            nchars += ((String*)ptr->values->list[i])->length + 1;
+        nvals += ptr->values->len;
+    }
+
+    size_t size = sizeof(_frozen_t_) 
+                + sizeof(_frozen_opt_t_) * nopts 
+                + sizeof(const char*) * nvals 
+                + nchars;
+    unsigned char* block = _ALLOC(size);
+
+    _frozen_t_* fz = (_frozen_t_*)block;
+    _frozen_opt_t_* opts = (_frozen_opt_t_*)(block + sizeof(_frozen_t_));
+    const char** values = (const char**)&opts[nopts];
+    char* chars = (char*)&values[nvals];
+
+    int vidx = 0;
+    post = 0;
+    for(int n = 0; NULL != (ptr = iterate_ptr_lst(cmdline->cmd_opts, &post)); n++) {
+        size_t len = strlen(ptr->name);
+        memcpy(chars, ptr->name, len + 1);
+        opts[n].name = chars;
+        opts[n].flag = ptr->flag;
+        opts[n].first = vidx;
+        opts[n].count = ptr->values->len;
+        chars += len + 1;
+
+        for(size_t i = 0; i < ptr->values->len; i++) {
+            String* val = (String*)ptr->values->list[i];
+            memcpy(chars, val->buffer, val->length);
+            chars[val->length] = '\0';
+            values[vidx++] = chars;
+            chars += val->length + 1;
         }
     }
 
+    qsort(opts, nopts, sizeof(_frozen_opt_t_), comp_frozen_opt);
+
+    fz->size = size;
+    fz->nopts = nopts;
+    fz->opts = opts;
+    fz->values = values;
+
+    cmdline->frozen = fz;
 }
 
 /**
@@ -265,6 +576,15 @@ void parse_cmdline(int argc, char** argv, int flag) {
  */
 const char* iterate_cmdline(const char* name, int* post) {
 
+    if(cmdline->frozen != NULL) {
+        const _frozen_opt_t_* fopt = search_frozen(name);
+        ASSERT_MSG(fopt != NULL, "cannot find the option searched for: %s", name);
+
+        if(*post < 0 || *post >= fopt->count)
+            return NULL;
+        return cmdline->frozen->values[fopt->first + (*post)++];
+    }
+
     _cmd_opt_t_* opt = search_name(name);
     ASSERT_MSG(opt != NULL, "cannot find the option searched for: %s", name);
 
@@ -280,6 +600,16 @@ const char* iterate_cmdline(const char* name, int* post) {
  */
 const char* get_cmdline(const char* name) {
 
+    if(cmdline->frozen != NULL) {
+        const _frozen_opt_t_* fopt = search_frozen(name);
+        ASSERT_MSG(fopt != NULL, "cannot find the option searched for: %s", name);
+
+        if((fopt->flag & CMD_RARG) || (fopt->flag & CMD_OARG))
+            return (fopt->count > 0)? cmdline->frozen->values[fopt->first]: NULL;
+        else
+            return (fopt->flag & CMD_SEEN)? fopt->name: NULL;
+    }
+
     _cmd_opt_t_* opt = search_name(name);
     ASSERT_MSG(opt != NULL, "cannot find the option searched for: %s", name);
 
@@ -295,85 +625,292 @@ const char* get_cmdline(const char* name) {
     }
 }
 
+#define HELP_COL    31  // column where the help text of an option starts
+#define MIN_WIDTH   50
+
 /**
- * @brief Show the help message and exit the program.
+ * @brief Return the width of the terminal, or of $COLUMNS, or 80.
  * 
+ * @return int 
  */
-void show_help() {
+static int term_width() {
 
-    char tmp[64];
+    int width = 0;
 
-    printf("\nUsage: %s [options]", cmdline->prog);
-    if(!cmdline->flag)
-        printf(" files\n");
-    else 
-        printf("\n");
+#ifdef TIOCGWINSZ
+    struct winsize ws;
+    if(isatty(STDOUT_FILENO) && ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0)
+        width = ws.ws_col;
+#endif
 
-    printf("%s v%s\n", cmdline->name, cmdline->version);
-    printf("%s\n\n", cmdline->intro);
-    printf("Options:\n");
-    printf("  Parm             Args        Help\n");
-    printf("-+----------------+-----------+---------------------------------------------\n");
+    if(width <= 0) {
+        const char* cols = getenv("COLUMNS");
+        if(cols != NULL)
+            width = atoi(cols);
+    }
 
-    int post = 0;
-    _cmd_opt_t_* ptr;
+    if(width <= 0)
+        width = 80;
+    else if(width < MIN_WIDTH)
+        width = MIN_WIDTH;
 
-    while(NULL != (ptr = iterate_ptr_lst(cmdline->cmd_opts, &post))) {
-        if(isgraph(ptr->short_opt) || strlen(ptr->long_opt) > 0) {
-            strcpy(tmp, " ");
-            if(isgraph(ptr->short_opt)) // could be zero
-                snprintf(tmp, sizeof(tmp), "-%c", ptr->short_opt);
-            printf("%4s", tmp);
-            //printf("%s", tmp);
-
-            strcpy(tmp, " ");
-            if(strlen(ptr->long_opt) > 0) // should never be NULL
-                snprintf(tmp, sizeof(tmp), "--%s", ptr->long_opt);
-            printf(" %-14s", tmp);
-            //printf(" %s", tmp);
-            
-            if((ptr->flag & CMD_RARG) || (ptr->flag & CMD_OARG)) {
-                int c = (ptr->flag & CMD_NUM)? 'N' : 
-                        (ptr->flag & CMD_STR)? 'S': 
-                        (ptr->flag & CMD_BOOL)? 'B' : '?';
-
-                if(ptr->flag & CMD_LIST) 
-                    snprintf(tmp, sizeof(tmp), "[%c,%c, ...]", c, c);    
-                else 
-                    snprintf(tmp, sizeof(tmp), "[%c]", c);    
-            }
-            else
-                strcpy(tmp, "  ");
-            printf("%-12s", tmp);
-            //printf("%s", tmp);
-
-            if(ptr->flag & CMD_REQD) 
-                snprintf(tmp, sizeof(tmp), "(reqd) %s", ptr->help);
-            else
-                snprintf(tmp, sizeof(tmp), "%s", ptr->help);
-            printf("%s\n", tmp);            
+    return width;
+}
+
+/**
+ * @brief Add spaces until the line that began at start reaches the column. 
+ * If it is already past the column then add one space.
+ * 
+ * @param out 
+ * @param start 
+ * @param col 
+ */
+static void pad_to(String* out, size_t start, size_t col) {
+
+    size_t used = out->length - start;
+    fill_buffer(out, ' ', (used >= col)? 1: col - used);
+}
+
+/**
+ * @brief Append text that is word wrapped to the width. The line that is 
+ * being added to started at start. Continuation lines are indented to the 
+ * indent column. Words that do not fit on a line by themselves are broken. 
+ * Always ends with a newline.
+ * 
+ * @param out 
+ * @param start 
+ * @param indent 
+ * @param width 
+ * @param text 
+ */
+static void append_wrapped(String* out, size_t start, size_t indent, size_t width, const char* text) {
+
+    size_t col = out->length - start;
+
+    while(*text != '\0') {
+        while(*text == ' ')
+            text++;
+        if(*text == '\0')
+            break;
+
+        size_t len = strcspn(text, " \n");
+        size_t need = (col > indent)? len + 1: len;
+
+        if(col + need > width && col > indent) {
+            // start a new line
+            append_string_char(out, '\n');
+            for(col = 0; col < indent; col++)
+                append_string_char(out, ' ');
+            need = len;
+        }
+        else if(col > indent)
+            append_string_char(out, ' ');
+
+        // a word that is too long for any line is broken
+        if(indent + len > width)
+            len = need = width - col;
+
+        append_buffer(out, (void*)text, len);
+        col += need;
+        text += len;
+
+        if(*text == '\n') {
+            append_string_char(out, '\n');
+            for(col = 0; col < indent; col++)
+                append_string_char(out, ' ');
+            text++;
+        }
+    }
+
+    append_string_char(out, '\n');
+}
+
+/**
+ * @brief Append the argument column, such as "[S]" or "[S,S, ...]".
+ * 
+ * @param out 
+ * @param c 
+ * @param list 
+ */
+static void render_arg(String* out, int c, int list) {
+
+    char tmp[12] = "[S,S, ...]";
+
+    tmp[1] = tmp[3] = c;
+    if(list)
+        append_buffer(out, tmp, 10);
+    else {
+        tmp[2] = ']';
+        append_buffer(out, tmp, 3);
+    }
+}
+
+/**
+ * @brief Append one line of the options table.
+ * 
+ * @param out 
+ * @param ptr 
+ * @param width 
+ */
+static void render_opt(String* out, _cmd_opt_t_* ptr, size_t width) {
+
+    size_t start = out->length;
+    int c = (ptr->flag & CMD_NUM)? 'N' : 
+            (ptr->flag & CMD_STR)? 'S': 
+            (ptr->flag & CMD_BOOL)? 'B' : '?';
+
+    if(isgraph(ptr->short_opt) || strlen(ptr->long_opt) > 0) {
+        if(isgraph(ptr->short_opt)) { // could be zero
+            append_string_str(out, "  -");
+            append_string_char(out, ptr->short_opt);
+            append_string_char(out, ' ');
+        }
+        else
+            append_string_str(out, "     ");
+
+        if(strlen(ptr->long_opt) > 0) { // should never be NULL
+            append_string_str(out, "--");
+            append_string_str(out, ptr->long_opt);
         }
-        else {
-            snprintf(tmp, sizeof(tmp), "%s", ptr->name);
-            printf("  %-17s", tmp);
-
-            int c = (ptr->flag & CMD_NUM)? 'N' : 
-                    (ptr->flag & CMD_STR)? 'S': 
-                    (ptr->flag & CMD_BOOL)? 'B' : '?';
-            snprintf(tmp, sizeof(tmp), "[%c,%c, ...]", c, c);            
-            printf("%-12s", tmp);
-
-            if(ptr->flag & CMD_REQD) 
-                snprintf(tmp, sizeof(tmp), "(reqd) %s", ptr->help);
-            else
-                snprintf(tmp, sizeof(tmp), "%s", ptr->help);
-            printf("%s\n", tmp);            
+        pad_to(out, start, 19);
+
+        if((ptr->flag & CMD_RARG) || (ptr->flag & CMD_OARG))
+            render_arg(out, c, ptr->flag & CMD_LIST);
+    }
+    else {
+        append_string_str(out, "  ");
+        append_string_str(out, ptr->name);
+        pad_to(out, start, 19);
+        render_arg(out, c, 1);
+    }
+    pad_to(out, start, HELP_COL);
+
+    if(ptr->flag & CMD_REQD) 
+        append_string_str(out, "(reqd)");
+    append_wrapped(out, start, HELP_COL, width, ptr->help);
+}
+
+/**
+ * @brief Append the line that separates the options table as wide as the 
+ * output.
+ * 
+ * @param out 
+ * @param width 
+ */
+static void render_rule(String* out, size_t width) {
+
+    size_t start = out->length;
+
+    append_string_str(out, "-+----------------+-----------+");
+    while(out->length - start < width)
+        append_string_char(out, '-');
+    append_string_char(out, '\n');
+}
+
+/**
+ * @brief Append the options table for the options from first up to, but not 
+ * including, last.
+ * 
+ * @param out 
+ * @param first 
+ * @param last 
+ * @param width 
+ */
+static void render_opts(String* out, int first, int last, size_t width) {
+
+    append_string_str(out, "  Parm             Args        Help\n");
+    render_rule(out, width);
+
+    for(int i = first; i < last; i++)
+        render_opt(out, (_cmd_opt_t_*)cmdline->cmd_opts->list[i], width);
+
+    render_rule(out, width);
+}
+
+/**
+ * @brief Render the help text into one string. If a subcommand has been 
+ * selected then only the global options and the options for that subcommand 
+ * are shown. Otherwise the list of subcommands is shown.
+ * 
+ * @return String* 
+ */
+static String* render_help() {
+
+    String* out = create_string(NULL);
+    size_t width = term_width();
+    int nopts = cmdline->cmd_opts->len;
+    int nglobal = (cmdline->subcmd != NULL)? cmdline->nglobal: nopts;
+    size_t start;
+
+    append_string_str(out, "\nUsage: ");
+    append_string_str(out, (cmdline->prog != NULL)? cmdline->prog: cmdline->name);
+    append_string_str(out, " [options]");
+    if(cmdline->subcmd != NULL) {
+        append_string_char(out, ' ');
+        append_string_str(out, cmdline->subcmd->name);
+        append_string_str(out, " [options]");
+    }
+    else if(cmdline->subcmds->len > 0)
+        append_string_str(out, " command [options]");
+    if(!cmdline->flag)
+        append_string_str(out, " files");
+    append_string_char(out, '\n');
+
+    append_string_str(out, cmdline->name);
+    append_string_str(out, " v");
+    append_string_str(out, cmdline->version);
+    append_string_char(out, '\n');
+    start = out->length;
+    append_wrapped(out, start, 0, width, cmdline->intro);
+    append_string_str(out, "\nOptions:\n");
+    render_opts(out, 0, nglobal, width);
+
+    if(cmdline->subcmd != NULL) {
+        append_string_str(out, "\nOptions for '");
+        append_string_str(out, cmdline->subcmd->name);
+        append_string_str(out, "':\n");
+        render_opts(out, nglobal, nopts, width);
+    }
+    append_string_str(out, "  S = string, N = number, B = bool ('on'|'off'|'true'|'false')\n");
+
+    if(cmdline->subcmd == NULL && cmdline->subcmds->len > 0) {
+        append_string_str(out, "\nCommands:\n");
+
+        int post = 0;
+        _subcmd_t_* ptr;
+        while(NULL != (ptr = iterate_ptr_lst(cmdline->subcmds, &post))) {
+            start = out->length;
+            append_string_str(out, "  ");
+            append_string_str(out, ptr->name);
+            pad_to(out, start, HELP_COL);
+            append_wrapped(out, start, HELP_COL, width, ptr->help);
         }
     }
-    printf("-+----------------+-----------+---------------------------------------------\n");
-    printf("  S = string, N = number, B = bool ('on'|'off'|'true'|'false')\n");
 
-    printf("\n%s\n\n", cmdline->outtro);
+    append_string_char(out, '\n');
+    start = out->length;
+    append_wrapped(out, start, 0, width, cmdline->outtro);
+    append_string_char(out, '\n');
+
+    return out;
+}
+
+/**
+ * @brief Show the help message and exit the program. The text is rendered 
+ * the first time it is needed and written with a single write() after that.
+ * 
+ */
+void show_help() {
+
+    if(cmdline->help == NULL) {
+        uint64_t start = trace_begin();
+        cmdline->help = render_help();
+        trace_end("help rendering", start);
+    }
+
+    fflush(stdout);
+    write_buffers_fd(STDOUT_FILENO, &cmdline->help, 1);
+
     exit(1);
 }
 
@@ -385,4 +922,115 @@ void show_version() {
 
     printf("%s v%s\n", cmdline->name, cmdline->version);
     exit(1);
-}
\ No newline at end of file
+}
+/******************************************************************************
+ * 
+ * Test Code
+ * 
+ */
+#ifdef TEST_FREEZE
+
+#include <pthread.h>
+
+#define NUM_OPTS    64
+#define NUM_ITEMS   8
+#define NUM_THREADS 8
+#define NUM_LOOPS   2000
+
+static char names[NUM_OPTS][16];
+static char longs[NUM_OPTS][16];
+static char args[NUM_OPTS][128];
+
+static void* reader(void* arg) {
+
+    long failed = 0;
+    (void)arg;
+
+    for(int loop = 0; loop < NUM_LOOPS; loop++) {
+        for(int i = 0; i < NUM_OPTS; i++) {
+            char expect[16];
+            const char* str;
+            int post = 0;
+            int count = 0;
+
+            while(NULL != (str = iterate_cmdline(names[i], &post))) {
+                snprintf(expect, sizeof(expect), "v%d_%d", i, count);
+                if(strcmp(str, expect))
+                    failed++;
+                count++;
+            }
+            if(count != NUM_ITEMS)
+                failed++;
+
+            snprintf(expect, sizeof(expect), "v%d_0", i);
+            if(strcmp(get_cmdline(names[i]), expect))
+                failed++;
+        }
+        if(get_cmdline("switch") == NULL || get_cmdline("unset") != NULL)
+            failed++;
+    }
+
+    return (void*)failed;
+}
+
+int main() {
+
+    char* argv[NUM_OPTS + 2];
+    int argc = 0;
+
+    init_cmdline("intro", "outtro", "test_freeze", "0.0");
+    argv[argc++] = "test_freeze";
+
+    // register in reverse so that the frozen sort actually moves things
+    for(int i = NUM_OPTS - 1; i >= 0; i--) {
+        snprintf(names[i], sizeof(names[i]), "name%d", i);
+        snprintf(longs[i], sizeof(longs[i]), "opt%d", i);
+        add_cmdline(0, longs[i], names[i], "help", NULL, NULL, CMD_STR|CMD_LIST|CMD_RARG);
+    }
+    add_cmdline(0, "switch", "switch", "help", NULL, NULL, CMD_BOOL);
+    add_cmdline('u', NULL, "unset", "help", NULL, NULL, CMD_BOOL);
+
+    for(int i = 0; i < NUM_OPTS; i++) {
+        int len = snprintf(args[i], sizeof(args[i]), "--opt%d=", i);
+        for(int j = 0; j < NUM_ITEMS; j++)
+            len += snprintf(&args[i][len], sizeof(args[i]) - len, "%sv%d_%d", (j > 0)? ",": "", i, j);
+        argv[argc++] = args[i];
+    }
+    argv[argc++] = "--switch";
+
+    parse_cmdline(argc, argv, REJECT_NOPT);
+    freeze_cmdline();
+
+    // take a copy of the frozen block so we can prove nothing wrote to it.
+    _frozen_t_* fz = cmdline->frozen;
+    void* snap = _COPY(fz, fz->size);
+
+    pthread_t threads[NUM_THREADS];
+    for(int i = 0; i < NUM_THREADS; i++)
+        pthread_create(&threads[i], NULL, reader, NULL);
+
+    long failed = 0;
+    for(int i = 0; i < NUM_THREADS; i++) {
+        void* res;
+        pthread_join(threads[i], &res);
+        failed += (long)res;
+    }
+
+    int changed = memcmp(snap, fz, fz->size);
+    printf("frozen block: %lu bytes, %d options\n", fz->size, fz->nopts);
+    printf("read failures: %ld\n", failed);
+    printf("block changed: %s\n", changed? "yes": "no");
+
+    _FREE(snap);
+    uninit_cmdline();
+
+    if(failed || changed) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("finished\n");
+    return 0;
+}
+
+#endif
@@ -15,6 +15,7 @@
 #include <stdbool.h>
 
 #include "str.h"
+#include "stats.h"
 
 typedef void (*cmdline_callback)();
 
@@ -43,6 +44,34 @@ typedef enum {
     CMD_SEEN = 0x80,
 } CmdType;
 
+/*
+ * Diagnostics are passed to a sink. The default sink collects them and 
+ * writes them to stderr all at once when parsing finishes. After the first 
+ * few messages with the same code, the rest are only counted and a summary 
+ * is given when the diagnostics are flushed.
+ */
+typedef enum {
+    DIAG_NOTE,
+    DIAG_WARNING,
+    DIAG_ERROR,     // the help is shown and the program exits
+} DiagLevel;
+
+typedef enum {
+    DIAG_GENERIC,
+    DIAG_DUPLICATE,     // an option value was given more than once
+    DIAG_UNKNOWN,       // unknown or ambiguous option or command
+    DIAG_SYNTAX,        // malformed option or argument
+    DIAG_MISSING,       // required option or argument is missing
+    DIAG_NUM_CODES
+} DiagCode;
+
+typedef void (*diag_sink)(DiagLevel level, DiagCode code, const char* msg, void* ctx);
+
+typedef enum {
+    EXPORT_JSON,
+    EXPORT_SHELL,
+} ExportFormat;
+
 #define ALLOW_NOPT 0
 #define REJECT_NOPT 1
 
@@ -53,7 +82,12 @@ void add_cmdline(int short_opt, const char* long_opt,
                     const char* name, const char* help, 
                     const char* def_val, 
                     cmdline_callback cb, CmdType flag);
+void add_subcmd(const char* name, const char* help, cmdline_callback cb);
 void parse_cmdline(int argc, char** argv, int flag);
+const char* get_subcmd();
+// After freeze_cmdline(), get_cmdline() and iterate_cmdline() perform no 
+// writes and may be called by any number of threads concurrently.
+void freeze_cmdline();
 const char* get_cmdline(const char* name);
 // int get_cmdline_as_num(const char* name);
 // bool get_cmdline_as_bool(const char* name);
@@ -63,4 +97,22 @@ const char* iterate_cmdline(const char* name, int* post);
 void show_help();
 void show_version();
 
+void set_diag_sink(diag_sink sink, void* ctx);
+void flush_diags();
+int get_diag_count(DiagCode code);
+
+void export_spec_json(Buffer* out);
+int export_spec_json_fd(int fd);
+void export_values(Buffer* out, ExportFormat fmt);
+int export_values_fd(int fd, ExportFormat fmt);
+
+void start_cmdline_trace(int nevents);
+void stop_cmdline_trace();
+void export_trace_json(Buffer* out);
+int export_trace_json_fd(int fd);
+
+int complete_cmdline(String* out, int cword, int argc, char** argv);
+void show_bash_completion();
+void show_zsh_completion();
+
 #endif  /* _CMDLINE_H_ */
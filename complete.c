@@ -0,0 +1,549 @@
+/**
+ * @file complete.c
+ *
+ * @brief Shell completion for the registered options. The query mode is
+ * entered with "prog --complete cword word0 word1 ..." and prints one
+ * candidate per line. It is run on every Tab keypress, so it uses the trie
+ * of long names and never renders the help text. This also emits static
+ * completion scripts for bash and zsh.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-02
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "myassert.h"
+#include "cmdline.h"
+#include "parse.h"
+#include "complete.h"
+
+// defined in cmdline.c, but not part of the public interface.
+_cmdline_t_* _get_cmdline_();
+_subcmd_t_* search_subcmd(const char* name);
+void select_subcmd(_subcmd_t_* sub);
+Trie* get_long_trie();
+
+static const char* bool_values[] = { "true", "false", "on", "off", NULL };
+
+/**
+ * @brief Add a candidate line to the output.
+ *
+ * @param out
+ * @param pre
+ * @param pre_len
+ * @param str
+ */
+static void add_candidate(String* out, const char* pre, size_t pre_len, const char* str) {
+
+    append_buffer(out, (void*)pre, pre_len);
+    append_string_str(out, str);
+    append_string_char(out, '\n');
+}
+
+/**
+ * @brief Complete the value of a "--name=value" word. Only bool options
+ * have a known set of values. For lists, the last item is completed.
+ *
+ * @param out
+ * @param word
+ * @param eq
+ * @return int
+ */
+static int complete_value(String* out, const char* word, const char* eq) {
+
+    const char* name = &word[2];
+    int count = 0;
+
+    _cmd_opt_t_* opt = find_trie(get_long_trie(), name, eq - name);
+    if(opt == NULL || !(opt->flag & CMD_BOOL) || !(opt->flag & (CMD_RARG|CMD_OARG)))
+        return 0;
+
+    const char* val = eq + 1;
+    if(opt->flag & CMD_LIST) {
+        const char* comma = strrchr(val, ',');
+        if(comma != NULL)
+            val = comma + 1;
+    }
+
+    size_t vlen = strlen(val);
+    for(int i = 0; bool_values[i] != NULL; i++) {
+        if(!strncmp(bool_values[i], val, vlen)) {
+            add_candidate(out, word, val - word, bool_values[i]);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Add one long option to the candidates. Called for each key under a 
+ * node of the trie.
+ *
+ * @param data
+ * @param ctx
+ */
+static void add_long(void* data, void* ctx) {
+
+    add_candidate((String*)ctx, "--", 2, ((_cmd_opt_t_*)data)->long_opt);
+}
+
+/**
+ * @brief Complete a "--prefix" word from the trie of long names. The node
+ * for the prefix is found in time proportional to its length and the node
+ * knows how many candidates are beneath it.
+ *
+ * @param out
+ * @param prefix
+ * @return int
+ */
+static int complete_long(String* out, const char* prefix) {
+
+    TrieNode* node = prefix_trie(get_long_trie(), prefix, strlen(prefix));
+    if(node == NULL)
+        return 0;
+
+    iterate_trie(node, add_long, out);
+    return node->count;
+}
+
+/**
+ * @brief Complete a "-abc" word by adding one more short option to it. A
+ * lone "-" also lists the long options.
+ *
+ * @param cmd
+ * @param out
+ * @param word
+ * @return int
+ */
+static int complete_short(_cmdline_t_* cmd, String* out, const char* word) {
+
+    size_t len = strlen(word);
+    int count = 0;
+
+    // an argument is being given, nothing to add
+    if(strchr(word, '=') != NULL || strchr(word, ':') != NULL)
+        return 0;
+
+    int post = 0;
+    _cmd_opt_t_* ptr;
+    while(NULL != (ptr = iterate_ptr_lst(cmd->cmd_opts, &post))) {
+        if(isgraph(ptr->short_opt)) {
+            char ch[2] = { (char)ptr->short_opt, '\0' };
+            add_candidate(out, word, len, ch);
+            count++;
+        }
+    }
+
+    if(len == 1)
+        count += complete_long(out, "");
+
+    return count;
+}
+
+/**
+ * @brief Complete the name of a subcommand.
+ *
+ * @param cmd
+ * @param out
+ * @param prefix
+ * @return int
+ */
+static int complete_subcmd(_cmdline_t_* cmd, String* out, const char* prefix) {
+
+    size_t len = strlen(prefix);
+    int count = 0;
+
+    int post = 0;
+    _subcmd_t_* ptr;
+    while(NULL != (ptr = iterate_ptr_lst(cmd->subcmds, &post))) {
+        if(!strncmp(ptr->name, prefix, len)) {
+            add_candidate(out, "", 0, ptr->name);
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Return the name of the program without the directory.
+ *
+ * @param cmd
+ * @return const char*
+ */
+static const char* prog_name(_cmdline_t_* cmd) {
+
+    const char* name = (cmd->prog != NULL)? cmd->prog: cmd->name;
+    const char* slash = strrchr(name, '/');
+
+    return (slash != NULL)? slash + 1: name;
+}
+
+/**
+ * @brief Append the program name with everything that is not valid in a
+ * shell function name replaced by '_'.
+ *
+ * @param out
+ * @param name
+ */
+static void append_func_name(String* out, const char* name) {
+
+    for(; *name != '\0'; name++)
+        append_string_char(out, isalnum((unsigned char)*name)? *name: '_');
+}
+
+/**
+ * @brief Append help text quoted for a zsh _arguments spec.
+ *
+ * @param out
+ * @param help
+ */
+static void append_zsh_help(String* out, const char* help) {
+
+    for(; *help != '\0'; help++) {
+        switch(*help) {
+            case '\'':
+                append_string_str(out, "'\\''");
+                break;
+            case '[':
+            case ']':
+            case ':':
+            case '\\':
+                append_string_char(out, '\\');
+                append_string_char(out, *help);
+                break;
+            default:
+                append_string_char(out, *help);
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Write all of the output to stdout and exit. Short writes to a pipe 
+ * are retried by write_buffers_fd().
+ *
+ * @param out
+ */
+static void write_and_exit(String* out) {
+
+    fflush(stdout);
+    if(write_buffers_fd(STDOUT_FILENO, &out, 1) < 0)
+        exit(1);
+    destroy_string(out);
+    exit(0);
+}
+
+/******************************************************************************
+ *
+ * Public Interface
+ *
+ */
+
+/**
+ * @brief Find the completion candidates for the word at argv[cword] and add
+ * them to the output, one per line. The argv is the whole command line as
+ * the shell sees it, including the program name. Candidates are short and
+ * long options, the values of bool options and subcommand names. If a
+ * subcommand appears before the word then it is selected so that its options
+ * can be completed. Returns the number of candidates.
+ *
+ * @param out
+ * @param cword
+ * @param argc
+ * @param argv
+ * @return int
+ */
+int complete_cmdline(String* out, int cword, int argc, char** argv) {
+
+    _cmdline_t_* cmd = _get_cmdline_();
+    ASSERT_MSG(cmd != NULL, "init the cmdline data structure before calling this.");
+
+    const char* word = (cword >= 0 && cword < argc)? argv[cword]: "";
+
+    // the subcommand registers its options when it is selected
+    if(cmd->subcmd == NULL && cmd->subcmds->len > 0) {
+        for(int i = 1; i < cword && i < argc; i++) {
+            if(argv[i][0] != '-') {
+                _subcmd_t_* sub = search_subcmd(argv[i]);
+                if(sub != NULL)
+                    select_subcmd(sub);
+                break;
+            }
+        }
+    }
+
+    if(word[0] == '-' && word[1] == '-') {
+        const char* eq = strchr(word, '=');
+        if(eq != NULL)
+            return complete_value(out, word, eq);
+        else
+            return complete_long(out, &word[2]);
+    }
+    else if(word[0] == '-')
+        return complete_short(cmd, out, word);
+    else if(cmd->subcmd == NULL && cmd->subcmds->len > 0)
+        return complete_subcmd(cmd, out, word);
+
+    // files and other words are left to the shell
+    return 0;
+}
+
+/**
+ * @brief Handle a "--complete" query from parse_cmdline(). Writes the
+ * candidates to stdout and exits.
+ *
+ * @param cword
+ * @param argc
+ * @param argv
+ */
+void run_completion(int cword, int argc, char** argv) {
+
+    String* out = create_string(NULL);
+    complete_cmdline(out, cword, argc, argv);
+    write_and_exit(out);
+}
+
+/**
+ * @brief Print a bash completion script for the registered options and exit.
+ * The options and subcommand names are listed in the script. Once a
+ * subcommand has been typed, the script asks the program through
+ * "--complete" because the subcommand options are not known until then.
+ *
+ */
+void show_bash_completion() {
+
+    _cmdline_t_* cmd = _get_cmdline_();
+    const char* name = prog_name(cmd);
+    String* out = create_string(NULL);
+
+    append_string_fmt(out, "# bash completion for %s\n_", name);
+    append_func_name(out, name);
+    append_string_str(out, "_complete() {\n");
+    append_string_str(out, "    local cur=\"${COMP_WORDS[COMP_CWORD]}\"\n");
+
+    if(cmd->subcmds->len > 0) {
+        append_string_str(out,
+            "    local i\n"
+            "    for (( i = 1; i < COMP_CWORD; i++ )); do\n"
+            "        if [[ \"${COMP_WORDS[i]}\" != -* ]]; then\n"
+            "            COMPREPLY=( $(\"${COMP_WORDS[0]}\" --complete \"$COMP_CWORD\" \"${COMP_WORDS[@]}\") )\n"
+            "            return\n"
+            "        fi\n"
+            "    done\n");
+    }
+
+    append_string_str(out, "    COMPREPLY=( $(compgen -W \"");
+
+    int post = 0;
+    _cmd_opt_t_* ptr;
+    while(NULL != (ptr = iterate_ptr_lst(cmd->cmd_opts, &post))) {
+        if(isgraph(ptr->short_opt))
+            append_string_fmt(out, "-%c ", ptr->short_opt);
+        if(strlen(ptr->long_opt) > 0)
+            append_string_fmt(out, "--%s ", ptr->long_opt);
+    }
+
+    post = 0;
+    _subcmd_t_* sub;
+    while(NULL != (sub = iterate_ptr_lst(cmd->subcmds, &post)))
+        append_string_fmt(out, "%s ", sub->name);
+
+    append_string_str(out, "\" -- \"$cur\") )\n}\ncomplete -o default -F _");
+    append_func_name(out, name);
+    append_string_fmt(out, "_complete %s\n", name);
+
+    write_and_exit(out);
+}
+
+/**
+ * @brief Print a zsh completion script for the registered options and exit.
+ * As with bash, subcommand options are asked for through "--complete".
+ *
+ */
+void show_zsh_completion() {
+
+    _cmdline_t_* cmd = _get_cmdline_();
+    const char* name = prog_name(cmd);
+    String* out = create_string(NULL);
+
+    append_string_fmt(out, "#compdef %s\n\n_", name);
+    append_func_name(out, name);
+    append_string_str(out, "() {\n    local -a orig=(\"${words[@]}\")\n");
+    append_string_str(out, "    local ocur=$CURRENT state\n");
+    append_string_str(out, "    _arguments -s \\\n");
+
+    int post = 0;
+    _cmd_opt_t_* ptr;
+    while(NULL != (ptr = iterate_ptr_lst(cmd->cmd_opts, &post))) {
+        bool args = (ptr->flag & (CMD_RARG|CMD_OARG)) != 0;
+        const char* vals = (ptr->flag & CMD_BOOL)? ":value:(true false on off)": ":value:";
+
+        if(isgraph(ptr->short_opt)) {
+            append_string_fmt(out, "        '-%c%s[", ptr->short_opt, args? "=": "");
+            append_zsh_help(out, ptr->help);
+            append_string_fmt(out, "]%s' \\\n", args? vals: "");
+        }
+        if(strlen(ptr->long_opt) > 0) {
+            append_string_fmt(out, "        '--%s%s[", ptr->long_opt, args? "=": "");
+            append_zsh_help(out, ptr->help);
+            append_string_fmt(out, "]%s' \\\n", args? vals: "");
+        }
+    }
+
+    if(cmd->subcmds->len > 0) {
+        append_string_str(out, "        '1:command:((");
+        post = 0;
+        _subcmd_t_* sub;
+        while(NULL != (sub = iterate_ptr_lst(cmd->subcmds, &post))) {
+            append_string_fmt(out, "%s\\:\"", sub->name);
+            append_zsh_help(out, sub->help);
+            append_string_str(out, "\" ");
+        }
+        append_string_str(out, "))' \\\n        '*:: :->args'\n");
+        append_string_str(out,
+            "    if [[ $state == args ]]; then\n"
+            "        compadd -- ${(f)\"$(\"${orig[1]}\" --complete $((ocur - 1)) \"${orig[@]}\")\"}\n"
+            "    fi\n");
+    }
+    else
+        append_string_str(out, "        '*:file:_files'\n");
+
+    append_string_str(out, "}\n\n_");
+    append_func_name(out, name);
+    append_string_str(out, " \"$@\"\n");
+
+    write_and_exit(out);
+}
+
+/******************************************************************************
+ *
+ * Test Code
+ *
+ */
+#ifdef TEST_COMPLETE
+
+#include <sys/wait.h>
+
+static int failed = 0;
+
+static void push_opts() {
+
+    add_cmdline('f', "force", "force", "do it anyway", NULL, NULL, CMD_NARG);
+}
+
+// the candidates for the last word of the line, one per line.
+static void check_complete(const char* line, const char* expect) {
+
+    char copy[256];
+    char* argv[16];
+    int argc = 0;
+
+    strcpy(copy, line);
+    for(char* tok = strtok(copy, " "); tok != NULL; tok = strtok(NULL, " "))
+        argv[argc++] = tok;
+    // a line that ends in a space completes an empty word
+    if(line[strlen(line) - 1] == ' ')
+        argv[argc++] = "";
+
+    String* out = create_string(NULL);
+    complete_cmdline(out, argc - 1, argc, argv);
+    if(strcmp(raw_string(out), expect)) {
+        printf("complete '%s':\n  got      '%s'\n  expected '%s'\n", line, raw_string(out), expect);
+        failed++;
+    }
+    destroy_string(out);
+}
+
+static void setup() {
+
+    init_cmdline("intro", "outtro", "prog", "1.0");
+    add_cmdline('v', "verbose", "verbose", "say more", NULL, NULL, CMD_NARG);
+    add_cmdline('c', "color", "color", "use color", NULL, NULL, CMD_BOOL|CMD_RARG);
+    add_cmdline(0, "colors", "colors", "color list", NULL, NULL, CMD_BOOL|CMD_LIST|CMD_RARG);
+    add_cmdline(0, "output", "output", "where to", NULL, NULL, CMD_STR|CMD_RARG);
+    add_subcmd("push", "send it", push_opts);
+    add_subcmd("pull", "get it", NULL);
+}
+
+int main() {
+
+    setup();
+    check_complete("prog -", "-v\n-c\n--color\n--colors\n--output\n--verbose\n");
+    check_complete("prog -v", "-vv\n-vc\n");
+    check_complete("prog --", "--color\n--colors\n--output\n--verbose\n");
+    check_complete("prog --col", "--color\n--colors\n");
+    check_complete("prog --x", "");
+    check_complete("prog --color=o", "--color=on\n--color=off\n");
+    check_complete("prog --colors=true,f", "--colors=true,false\n");
+    check_complete("prog --output=", "");
+    check_complete("prog pu", "push\npull\n");
+    check_complete("prog pul", "pull\n");
+    uninit_cmdline();
+
+    // the subcommand before the word registers its own options
+    setup();
+    check_complete("prog push --f", "--force\n");
+    uninit_cmdline();
+
+    // a "--complete" query writes everything, even when it is far larger 
+    // than a pipe holds
+    char name[32];
+    setup();
+    for(int i = 0; i < 5000; i++) {
+        snprintf(name, sizeof(name), "long-option-%d", i);
+        add_cmdline(0, name, name, "help", NULL, NULL, CMD_NARG);
+    }
+    String* expect = create_string(NULL);
+    char* argv[] = { "prog", "--" };
+    complete_cmdline(expect, 1, 2, argv);
+
+    int fds[2];
+    if(pipe(fds) < 0)
+        return 1;
+    pid_t pid = fork();
+    if(pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        run_completion(1, 2, argv);
+    }
+    close(fds[1]);
+
+    String* got = create_string(NULL);
+    char tmp[4096];
+    ssize_t n;
+    while(0 < (n = read(fds[0], tmp, sizeof(tmp))))
+        append_buffer(got, tmp, n);
+    close(fds[0]);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0 || comp_buffer(got, expect)) {
+        printf("run_completion: wrote %lu of %lu bytes\n", got->length, expect->length);
+        failed++;
+    }
+    printf("query output: %lu bytes\n", got->length);
+
+    destroy_string(got);
+    destroy_string(expect);
+    uninit_cmdline();
+
+    if(failed) {
+        printf("FAILED: %d checks\n", failed);
+        return 1;
+    }
+
+    printf("finished\n");
+    return 0;
+}
+
+#endif
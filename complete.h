@@ -0,0 +1,17 @@
+/**
+ * @file complete.h
+ *
+ * @brief Internal interface for shell completion.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-02
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef _COMPLETE_H_
+#define _COMPLETE_H_
+
+void run_completion(int cword, int argc, char** argv);
+
+#endif  /* _COMPLETE_H_ */
@@ -1,62 +1,301 @@
 /**
  * @file errors.c
- * 
- * @brief 
- * 
+ *
+ * @brief Diagnostics for the command line parser. Messages are passed to a
+ * sink that the application can replace. The default sink collects them in
+ * a String and writes them to stderr in one piece when they are flushed.
+ * Each message has a code and the number of messages for each code is
+ * counted. After REPEAT_LIMIT messages with the same code, the rest are
+ * only counted and a summary is given when the diagnostics are flushed.
+ * Messages are only held back while a parse is in progress; at other times
+ * they are written as soon as they are given.
+ *
  * @author Chuck Tilbury (chucktilbury@gmail.com)
  * @version 0.0
  * @date 2024-06-17
  * @copyright Copyright (c) 2024
- * 
+ *
  */
 #include <stdio.h>
 #include <stdarg.h>
+#include <unistd.h>
 
+#include "memory.h"
 #include "cmdline.h"
+#include "errors.h"
+
+#define REPEAT_LIMIT 3
+
+static diag_sink sink = NULL;   // NULL selects the default sink
+static void* sink_ctx = NULL;
+static String* pending = NULL;  // output of the default sink
+static int counts[DIAG_NUM_CODES];
+static int suppressed[DIAG_NUM_CODES];
+static int batching = 0;        // non-zero while a parse is in progress
+
+static const char* code_names[DIAG_NUM_CODES] = {
+    "general",
+    "duplicate option value",
+    "unknown option",
+    "syntax",
+    "missing option",
+};
+
+/**
+ * @brief Collect the message to be written when the diagnostics are
+ * flushed.
+ *
+ * @param level
+ * @param code
+ * @param msg
+ * @param ctx
+ */
+static void default_sink(DiagLevel level, DiagCode code, const char* msg, void* ctx) {
+
+    (void)code;
+    (void)ctx;
+
+    if(pending == NULL)
+        pending = create_string(NULL);
+
+    append_string_str(pending, (level == DIAG_ERROR)? "\nCMD ERROR: ":
+                               (level == DIAG_WARNING)? "\nCMD WARNING: ": "\nCMD NOTE: ");
+    append_string_str(pending, msg);
+    append_string_char(pending, '\n');
+}
+
+/**
+ * @brief Write out anything that the default sink has collected.
+ *
+ */
+static void write_pending() {
+
+    if(pending != NULL && pending->length > 0) {
+        fflush(stderr);
+        write_buffers_fd(STDERR_FILENO, &pending, 1);
+        clear_string(pending);
+    }
+}
+
+/**
+ * @brief Pass the message to the sink.
+ *
+ * @param level
+ * @param code
+ * @param msg
+ */
+static void deliver(DiagLevel level, DiagCode code, const char* msg) {
+
+    if(sink != NULL)
+        (*sink)(level, code, msg, sink_ctx);
+    else
+        default_sink(level, code, msg, NULL);
+
+    if(!batching)
+        write_pending();
+}
+
+/**
+ * @brief Format the message and pass it on, unless there have already been
+ * too many with the same code. Then it is only counted and never formatted.
+ * Errors are always passed. Short messages are formatted on the stack.
+ *
+ * @param level
+ * @param code
+ * @param fmt
+ * @param args
+ */
+static void vdiag(DiagLevel level, DiagCode code, const char* fmt, va_list args) {
+
+    char tmp[256];
+    va_list copy;
+
+    counts[code]++;
+    if(level != DIAG_ERROR && counts[code] > REPEAT_LIMIT) {
+        suppressed[code]++;
+        return;
+    }
+
+    va_copy(copy, args);
+    int len = vsnprintf(tmp, sizeof(tmp), fmt, copy);
+    va_end(copy);
+
+    if(len >= (int)sizeof(tmp)) {
+        char* b = _ALLOC(len + 1);
+        vsnprintf(b, len + 1, fmt, args);
+        deliver(level, code, b);
+        _FREE(b);
+    }
+    else
+        deliver(level, code, tmp);
+}
+
+/******************************************************************************
+ *
+ * Internal Interface
+ *
+ */
+
+/**
+ * @brief Hold the diagnostics back until the parse ends. This is called
+ * when parsing starts.
+ *
+ */
+void begin_diags() {
+
+    batching = 1;
+}
+
+/**
+ * @brief Stop holding the diagnostics back and write out everything that
+ * was collected during the parse.
+ *
+ */
+void end_diags() {
+
+    batching = 0;
+    flush_diags();
+}
+
+/**
+ * @brief Write out anything that is left, free the collected output and
+ * forget the counts so the next parse starts clean. This is called when
+ * the command line is uninitialized.
+ *
+ */
+void reset_diags() {
+
+    batching = 0;
+    flush_diags();
+    if(pending != NULL) {
+        destroy_string(pending);
+        pending = NULL;
+    }
+
+    for(int i = 0; i < DIAG_NUM_CODES; i++) {
+        counts[i] = 0;
+        suppressed[i] = 0;
+    }
+}
+
+/******************************************************************************
+ *
+ * Public Interface
+ *
+ */
+
+/**
+ * @brief Replace the sink that receives the diagnostics. The context is
+ * passed to every call of the sink. A NULL sink selects the default one,
+ * which writes to stderr when the diagnostics are flushed.
+ *
+ * @param func
+ * @param ctx
+ */
+void set_diag_sink(diag_sink func, void* ctx) {
+
+    flush_diags();
+    sink = func;
+    sink_ctx = ctx;
+}
+
+/**
+ * @brief Give a summary for each code that had messages suppressed and
+ * write out anything that the default sink has collected. This is called
+ * when parsing finishes and before the program exits on an error.
+ *
+ */
+void flush_diags() {
+
+    for(int i = 0; i < DIAG_NUM_CODES; i++) {
+        if(suppressed[i] > 0) {
+            char tmp[128];
+            snprintf(tmp, sizeof(tmp), "%d more '%s' messages were not shown",
+                        suppressed[i], code_names[i]);
+            suppressed[i] = 0;
+
+            if(sink != NULL)
+                (*sink)(DIAG_NOTE, (DiagCode)i, tmp, sink_ctx);
+            else
+                default_sink(DIAG_NOTE, (DiagCode)i, tmp, NULL);
+        }
+    }
+
+    write_pending();
+}
+
+/**
+ * @brief Return the number of diagnostics that have been given with the
+ * code, including the ones that were not shown.
+ *
+ * @param code
+ * @return int
+ */
+int get_diag_count(DiagCode code) {
+
+    return counts[code];
+}
+
+/**
+ * @brief Give a diagnostic with a level and a code. If the level is an
+ * error then the diagnostics are flushed, the help is shown and the program
+ * exits. A leading '+' in the format prevents that.
+ *
+ * @param level
+ * @param code
+ * @param fmt
+ * @param ...
+ */
+void diag(DiagLevel level, DiagCode code, const char* fmt, ...) {
+
+    va_list args;
+
+    const char* format = (fmt[0] == '+')? &fmt[1]: fmt;
+    va_start(args, fmt);
+    vdiag(level, code, format, args);
+    va_end(args);
+
+    if(level == DIAG_ERROR && fmt[0] != '+') {
+        flush_diags();
+        show_help();
+    }
+}
 
 /**
  * @brief Show an error message and then show the help message and then
  * exit the program.
- * 
- * @param fmt 
- * @param ... 
+ *
+ * @param fmt
+ * @param ...
  */
 void error(const char* fmt, ...) {
 
     va_list args;
 
-    fprintf(stderr, "\nCMD ERROR: ");
-
     const char* format = (fmt[0] == '+')? &fmt[1]: fmt;
     va_start(args, fmt);
-    vfprintf(stderr, format, args);
+    vdiag(DIAG_ERROR, DIAG_GENERIC, format, args);
     va_end(args);
 
     if(fmt[0] != '+') {
-        fputs("\n", stderr);
+        flush_diags();
         show_help();
     }
 }
 
 /**
  * @brief Show a warning message and continue.
- * 
- * @param fmt 
- * @param ... 
+ *
+ * @param fmt
+ * @param ...
  */
 void warning(const char* fmt, ...) {
 
     va_list args;
 
-    fprintf(stderr, "\nCMD WARNING: ");
-
     const char* format = (fmt[0] == '+')? &fmt[1]: fmt;
     va_start(args, fmt);
-    vfprintf(stderr, format, args);
+    vdiag(DIAG_WARNING, DIAG_GENERIC, format, args);
     va_end(args);
-
-    if(fmt[0] != '+') {
-        fputs("\n", stderr);
-    }
 }
 
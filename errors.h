@@ -1,7 +1,14 @@
 #ifndef _ERRORS_H_
 #define _ERRORS_H_
 
+#include "cmdline.h"
+
+void diag(DiagLevel level, DiagCode code, const char* fmt, ...);
 void error(const char* fmt, ...);
 void warning(const char* fmt, ...);
 
+void begin_diags();
+void end_diags();
+void reset_diags();
+
 #endif  /* _ERRORS_H_ */
@@ -0,0 +1,845 @@
+/**
+ * @file export.c
+ *
+ * @brief Machine readable export of the registered options. The output is
+ * streamed as it is produced. It is either appended to a Buffer, or written
+ * to a file descriptor in large chunks through a Buffer that is reused, so
+ * no document is built in memory and the registry is walked once.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-12
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+
+#include "memory.h"
+#include "myassert.h"
+#include "cmdline.h"
+#include "parse.h"
+#include "trace.h"
+#include "trie.h"
+
+#define CHUNK_SIZE  (1024 * 64)
+
+// defined in cmdline.c, but not part of the public interface.
+_cmdline_t_* _get_cmdline_();
+
+typedef struct {
+    Buffer* buf;
+    int fd;     // -1 when the output stays in the buffer
+    int error;  // set if a write to the fd failed
+} _emitter_t_;
+
+/**
+ * @brief Write the whole buffer to the fd and empty it.
+ *
+ * @param em
+ */
+static void flush_emitter(_emitter_t_* em) {
+
+    if(!em->error && write_buffers_fd(em->fd, &em->buf, 1) < 0)
+        em->error = 1;
+
+    clear_string(em->buf);
+}
+
+/**
+ * @brief Called between items. Writes the chunk out once it is large enough.
+ *
+ * @param em
+ */
+static inline void check_emitter(_emitter_t_* em) {
+
+    if(em->fd >= 0 && em->buf->length >= CHUNK_SIZE)
+        flush_emitter(em);
+}
+
+static inline void emit(_emitter_t_* em, const char* str, size_t len) {
+
+    append_buffer(em->buf, (void*)str, len);
+}
+
+static inline void emit_str(_emitter_t_* em, const char* str) {
+
+    append_buffer(em->buf, (void*)str, strlen(str));
+}
+
+/**
+ * @brief Emit a JSON string from len bytes. Runs of characters that need no 
+ * escape are copied in one piece.
+ *
+ * @param em
+ * @param str
+ * @param len
+ */
+static void emit_json_mem(_emitter_t_* em, const char* str, size_t len) {
+
+    static const char hex[] = "0123456789abcdef";
+    const char* run = str;
+    const char* end = str + len;
+
+    emit(em, "\"", 1);
+    for(; str < end; str++) {
+        unsigned char ch = (unsigned char)*str;
+        if(ch >= 0x20 && ch != '"' && ch != '\\')
+            continue;
+
+        emit(em, run, str - run);
+        run = str + 1;
+        switch(ch) {
+            case '"':  emit(em, "\\\"", 2); break;
+            case '\\': emit(em, "\\\\", 2); break;
+            case '\n': emit(em, "\\n", 2); break;
+            case '\r': emit(em, "\\r", 2); break;
+            case '\t': emit(em, "\\t", 2); break;
+            default: {
+                char esc[6] = { '\\', 'u', '0', '0', hex[ch >> 4], hex[ch & 0xf] };
+                emit(em, esc, 6);
+            }
+            break;
+        }
+    }
+    emit(em, run, str - run);
+    emit(em, "\"", 1);
+}
+
+static inline void emit_json_str(_emitter_t_* em, const char* str) {
+
+    emit_json_mem(em, str, strlen(str));
+}
+
+/**
+ * @brief Emit len bytes in single quotes for the shell. A single quote is 
+ * written as '\''.
+ *
+ * @param em
+ * @param str
+ * @param len
+ */
+static void emit_shell_mem(_emitter_t_* em, const char* str, size_t len) {
+
+    const char* end = str + len;
+    const char* quote;
+
+    emit(em, "'", 1);
+    while(NULL != (quote = memchr(str, '\'', end - str))) {
+        emit(em, str, quote - str);
+        emit(em, "'\\''", 4);
+        str = quote + 1;
+    }
+    emit(em, str, end - str);
+    emit(em, "'", 1);
+}
+
+/**
+ * @brief Emit a JSON string or null for a NULL or empty string.
+ *
+ * @param em
+ * @param str
+ */
+static void emit_json_opt_str(_emitter_t_* em, const char* str) {
+
+    if(str == NULL || *str == '\0')
+        emit(em, "null", 4);
+    else
+        emit_json_str(em, str);
+}
+
+/**
+ * @brief Return the name of the type of the option.
+ *
+ * @param flag
+ * @return const char*
+ */
+static const char* type_name(int flag) {
+
+    return (flag & CMD_NUM)? "number":
+           (flag & CMD_STR)? "string":
+           (flag & CMD_BOOL)? "bool": "none";
+}
+
+/**
+ * @brief Return the name of the argument mode of the option.
+ *
+ * @param flag
+ * @return const char*
+ */
+static const char* arg_name(int flag) {
+
+    return (flag & CMD_RARG)? "required":
+           (flag & CMD_OARG)? "optional": "none";
+}
+
+/**
+ * @brief Emit one option of the spec as a JSON object.
+ *
+ * @param em
+ * @param opt
+ */
+static void emit_spec_opt(_emitter_t_* em, _cmd_opt_t_* opt) {
+
+    emit_str(em, "{\"name\":");
+    emit_json_opt_str(em, opt->name);
+
+    emit_str(em, ",\"short\":");
+    if(isgraph(opt->short_opt)) {
+        char ch[2] = { (char)opt->short_opt, '\0' };
+        emit_json_str(em, ch);
+    }
+    else
+        emit(em, "null", 4);
+
+    emit_str(em, ",\"long\":");
+    emit_json_opt_str(em, opt->long_opt);
+
+    emit_str(em, ",\"type\":\"");
+    emit_str(em, type_name(opt->flag));
+    emit_str(em, "\",\"list\":");
+    emit_str(em, (opt->flag & CMD_LIST)? "true": "false");
+    emit_str(em, ",\"required\":");
+    emit_str(em, (opt->flag & CMD_REQD)? "true": "false");
+    emit_str(em, ",\"arg\":\"");
+    emit_str(em, arg_name(opt->flag));
+
+    emit_str(em, "\",\"default\":");
+    if(opt->def_val != NULL)
+        emit_json_str(em, opt->def_val);
+    else
+        emit(em, "null", 4);
+
+    emit_str(em, ",\"help\":");
+    emit_json_str(em, opt->help);
+    emit(em, "}", 1);
+}
+
+/**
+ * @brief Stream the whole spec.
+ *
+ * @param em
+ */
+static void emit_spec(_emitter_t_* em) {
+
+    _cmdline_t_* cmd = _get_cmdline_();
+    ASSERT_MSG(cmd != NULL, "init the cmdline data structure before calling this.");
+
+    emit_str(em, "{\"name\":");
+    emit_json_str(em, cmd->name);
+    emit_str(em, ",\"version\":");
+    emit_json_str(em, cmd->version);
+    emit_str(em, ",\"subcommand\":");
+    emit_json_opt_str(em, (cmd->subcmd != NULL)? cmd->subcmd->name: NULL);
+    emit_str(em, ",\"options\":[");
+
+    int post = 0;
+    _cmd_opt_t_* opt;
+    while(NULL != (opt = iterate_ptr_lst(cmd->cmd_opts, &post))) {
+        if(post > 1)
+            emit(em, ",", 1);
+        emit_spec_opt(em, opt);
+        check_emitter(em);
+    }
+
+    emit_str(em, "],\"subcommands\":[");
+
+    post = 0;
+    _subcmd_t_* sub;
+    while(NULL != (sub = iterate_ptr_lst(cmd->subcmds, &post))) {
+        if(post > 1)
+            emit(em, ",", 1);
+        emit_str(em, "{\"name\":");
+        emit_json_str(em, sub->name);
+        emit_str(em, ",\"help\":");
+        emit_json_str(em, sub->help);
+        emit(em, "}", 1);
+        check_emitter(em);
+    }
+
+    emit_str(em, "]}\n");
+}
+
+/**
+ * @brief Return where the value of the option came from.
+ *
+ * @param opt
+ * @return const char*
+ */
+static const char* source_name(_cmd_opt_t_* opt) {
+
+    return (opt->flag & CMD_SEEN)? "cmdline":
+           (opt->values->len > 0)? "default": "unset";
+}
+
+// a switch has no argument, its value is whether it was seen.
+static inline int is_switch(_cmd_opt_t_* opt) {
+
+    return !(opt->flag & (CMD_RARG|CMD_OARG|CMD_LIST)) && opt->values->len == 0;
+}
+
+// the option that has no name on the command line always holds a list.
+static inline int is_list(_cmd_opt_t_* opt) {
+
+    return (opt->flag & CMD_LIST) || (opt->short_opt == 0 && *opt->long_opt == '\0');
+}
+
+/**
+ * @brief Emit the value of one option as a JSON object. Lists become arrays
+ * and switches become true or false.
+ *
+ * @param em
+ * @param opt
+ */
+static void emit_json_value(_emitter_t_* em, _cmd_opt_t_* opt) {
+
+    emit_str(em, "{\"name\":");
+    emit_json_str(em, opt->name);
+    emit_str(em, ",\"source\":\"");
+    emit_str(em, source_name(opt));
+    emit_str(em, "\",\"value\":");
+
+    if(is_switch(opt))
+        emit_str(em, (opt->flag & CMD_SEEN)? "true": "false");
+    else if(is_list(opt)) {
+        emit(em, "[", 1);
+        for(size_t i = 0; i < opt->values->len; i++) {
+            String* val = (String*)opt->values->list[i];
+            if(i > 0)
+                emit(em, ",", 1);
+            emit_json_mem(em, (const char*)val->buffer, val->length);
+            check_emitter(em);
+        }
+        emit(em, "]", 1);
+    }
+    else if(opt->values->len > 0) {
+        String* val = (String*)opt->values->list[0];
+        emit_json_mem(em, (const char*)val->buffer, val->length);
+    }
+    else
+        emit(em, "null", 4);
+
+    emit(em, "}", 1);
+}
+
+/**
+ * @brief Make the name of the option into a valid variable name in var. 
+ * Other characters become '_' and a leading digit gets a '_' in front of it.
+ *
+ * @param var
+ * @param name
+ */
+static void shell_name(String* var, const char* name) {
+
+    clear_string(var);
+    if(isdigit((unsigned char)*name))
+        append_string_char(var, '_');
+
+    const char* run = name;
+    for(; *name != '\0'; name++) {
+        if(!isalnum((unsigned char)*name) && *name != '_') {
+            append_buffer(var, (void*)run, name - run);
+            append_string_char(var, '_');
+            run = name + 1;
+        }
+    }
+    append_buffer(var, (void*)run, name - run);
+}
+
+/**
+ * @brief Put the variable name of the option in var. Every name has already 
+ * been reserved by the first option that maps to it. Any other option that 
+ * maps to the same name gets "_2", "_3" and so on, skipping the names that 
+ * are reserved or already given out.
+ *
+ * @param var
+ * @param opt
+ * @param names
+ */
+static void claim_shell_name(String* var, _cmd_opt_t_* opt, Trie* names) {
+
+    shell_name(var, opt->name);
+    if(find_trie(names, raw_string(var), var->length) == opt)
+        return;
+
+    size_t len = var->length;
+    for(int n = 2;; n++) {
+        var->length = len;
+        append_string_char(var, '_');
+        append_string_int(var, n);
+        if(find_trie(names, raw_string(var), var->length) == NULL)
+            break;
+    }
+    insert_trie(names, raw_string(var), opt);
+}
+
+/**
+ * @brief Emit the value of one option as a shell assignment, followed by a 
+ * comment that gives the source. The name comes from claim_shell_name(), 
+ * which uses var as scratch space. Lists are written as a bash array.
+ *
+ * @param em
+ * @param opt
+ * @param names
+ * @param var
+ */
+static void emit_shell_value(_emitter_t_* em, _cmd_opt_t_* opt, Trie* names, String* var) {
+
+    claim_shell_name(var, opt, names);
+    emit(em, raw_string(var), var->length);
+    emit(em, "=", 1);
+
+    if(is_switch(opt))
+        emit_str(em, (opt->flag & CMD_SEEN)? "true": "false");
+    else if(is_list(opt)) {
+        emit(em, "(", 1);
+        for(size_t i = 0; i < opt->values->len; i++) {
+            String* val = (String*)opt->values->list[i];
+            if(i > 0)
+                emit(em, " ", 1);
+            emit_shell_mem(em, (const char*)val->buffer, val->length);
+            check_emitter(em);
+        }
+        emit(em, ")", 1);
+    }
+    else if(opt->values->len > 0) {
+        String* val = (String*)opt->values->list[0];
+        emit_shell_mem(em, (const char*)val->buffer, val->length);
+    }
+
+    emit_str(em, "  # ");
+    emit_str(em, source_name(opt));
+    emit(em, "\n", 1);
+}
+
+/**
+ * @brief Stream the value of every option that has a name.
+ *
+ * @param em
+ * @param fmt
+ */
+static void emit_values(_emitter_t_* em, ExportFormat fmt) {
+
+    _cmdline_t_* cmd = _get_cmdline_();
+    ASSERT_MSG(cmd != NULL, "init the cmdline data structure before calling this.");
+
+    int first = 1;
+    int post = 0;
+    _cmd_opt_t_* opt;
+    Trie* names = NULL;
+    String* var = NULL;
+
+    if(fmt == EXPORT_JSON)
+        emit_str(em, "[");
+    else {
+        // reserve the plain variable name of every option before any of 
+        // them is given a suffix, so the output does not depend on the order
+        names = create_trie();
+        var = create_string(NULL);
+        while(NULL != (opt = iterate_ptr_lst(cmd->cmd_opts, &post))) {
+            if(*opt->name == '\0')
+                continue;
+            shell_name(var, opt->name);
+            if(find_trie(names, raw_string(var), var->length) == NULL)
+                insert_trie(names, raw_string(var), opt);
+        }
+        post = 0;
+    }
+
+    while(NULL != (opt = iterate_ptr_lst(cmd->cmd_opts, &post))) {
+        if(*opt->name == '\0')
+            continue;
+
+        if(fmt == EXPORT_JSON) {
+            if(!first)
+                emit(em, ",", 1);
+            emit_json_value(em, opt);
+        }
+        else
+            emit_shell_value(em, opt, names, var);
+
+        first = 0;
+        check_emitter(em);
+    }
+
+    if(fmt == EXPORT_JSON)
+        emit_str(em, "]\n");
+    else {
+        destroy_string(var);
+        destroy_trie(names);
+    }
+}
+
+/**
+ * @brief Emit a time in nanoseconds as microseconds, which is the unit of the 
+ * trace format.
+ *
+ * @param em
+ * @param ns
+ */
+static void emit_usec(_emitter_t_* em, uint64_t ns) {
+
+    append_int_buffer(em->buf, (long long)(ns / 1000), 0);
+    emit(em, ".", 1);
+    append_int_buffer(em->buf, (long long)(ns % 1000), 3);
+}
+
+/**
+ * @brief Stream the recorded phases as complete events.
+ *
+ * @param em
+ */
+static void emit_trace(_emitter_t_* em) {
+
+    int pid = (int)getpid();
+
+    emit_str(em, "{\"traceEvents\":[");
+
+    int post = 0;
+    const _trace_event_t_* ev;
+    while(NULL != (ev = iterate_trace(&post))) {
+        if(post > 1)
+            emit(em, ",", 1);
+        emit_str(em, "\n{\"name\":");
+        emit_json_str(em, ev->name);
+        emit_str(em, ",\"cat\":\"cmdline\",\"ph\":\"X\",\"ts\":");
+        emit_usec(em, ev->start);
+        emit_str(em, ",\"dur\":");
+        emit_usec(em, ev->dur);
+        emit_str(em, ",\"pid\":");
+        append_int_buffer(em->buf, pid, 0);
+        emit_str(em, ",\"tid\":");
+        append_int_buffer(em->buf, pid, 0);
+        emit(em, "}", 1);
+        check_emitter(em);
+    }
+
+    emit_str(em, "\n],\"displayTimeUnit\":\"ms\"}\n");
+}
+
+/******************************************************************************
+ *
+ * Public Interface
+ *
+ */
+
+/**
+ * @brief Append the registered options to the buffer as JSON. For each
+ * option this gives the short and long names, the type, whether it is a
+ * list or required, the argument mode, the default value and the help. If a
+ * subcommand has been selected then its options are included.
+ *
+ * @param out
+ */
+void export_spec_json(Buffer* out) {
+
+    _emitter_t_ em = { out, -1, 0 };
+    emit_spec(&em);
+}
+
+/**
+ * @brief Write the registered options to the fd as JSON. The output is
+ * written in chunks as it is produced. Returns 0 on success or -1 if a
+ * write failed.
+ *
+ * @param fd
+ * @return int
+ */
+int export_spec_json_fd(int fd) {
+
+    _emitter_t_ em = { create_buffer(NULL, 0), fd, 0 };
+
+    emit_spec(&em);
+    flush_emitter(&em);
+    destroy_buffer(em.buf);
+
+    return em.error? -1: 0;
+}
+
+/**
+ * @brief Append the effective value of every named option to the buffer, 
+ * with where it came from: "cmdline", "default" or "unset". The format is 
+ * either a JSON array or shell assignments. The registry is walked once and 
+ * the values are copied straight from the options.
+ *
+ * @param out
+ * @param fmt
+ */
+void export_values(Buffer* out, ExportFormat fmt) {
+
+    _emitter_t_ em = { out, -1, 0 };
+    emit_values(&em, fmt);
+}
+
+/**
+ * @brief Write the effective value of every named option to the fd. The 
+ * output is written in chunks as it is produced. Returns 0 on success or -1 
+ * if a write failed.
+ *
+ * @param fd
+ * @param fmt
+ * @return int
+ */
+int export_values_fd(int fd, ExportFormat fmt) {
+
+    _emitter_t_ em = { create_buffer(NULL, 0), fd, 0 };
+
+    emit_values(&em, fmt);
+    flush_emitter(&em);
+    destroy_buffer(em.buf);
+
+    return em.error? -1: 0;
+}
+
+/**
+ * @brief Append the phases recorded since start_cmdline_trace() to the 
+ * buffer in the Chrome trace format. The output can be loaded by 
+ * chrome://tracing or Perfetto.
+ *
+ * @param out
+ */
+void export_trace_json(Buffer* out) {
+
+    _emitter_t_ em = { out, -1, 0 };
+    emit_trace(&em);
+}
+
+/**
+ * @brief Write the recorded phases to the fd in the Chrome trace format. 
+ * Returns 0 on success or -1 if a write failed.
+ *
+ * @param fd
+ * @return int
+ */
+int export_trace_json_fd(int fd) {
+
+    _emitter_t_ em = { create_buffer(NULL, 0), fd, 0 };
+
+    emit_trace(&em);
+    flush_emitter(&em);
+    destroy_buffer(em.buf);
+
+    return em.error? -1: 0;
+}
+
+/******************************************************************************
+ *
+ * Test Code
+ *
+ */
+#ifdef TEST_EXPORT
+
+#include <stdlib.h>
+
+static int failed = 0;
+
+// a small recursive descent check that the text is one JSON value.
+static const char* skip_json_ws(const char* p) {
+
+    while(*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')
+        p++;
+    return p;
+}
+
+static const char* check_json_value(const char* p);
+
+static const char* check_json_string(const char* p) {
+
+    if(*p++ != '"')
+        return NULL;
+    while(*p != '"') {
+        if((unsigned char)*p < 0x20)
+            return NULL;
+        if(*p == '\\') {
+            p++;
+            if(*p == 'u') {
+                for(int i = 1; i <= 4; i++)
+                    if(!isxdigit((unsigned char)p[i]))
+                        return NULL;
+                p += 4;
+            }
+            else if(strchr("\"\\/bfnrt", *p) == NULL || *p == '\0')
+                return NULL;
+        }
+        p++;
+    }
+    return p + 1;
+}
+
+static const char* check_json_list(const char* p, char close, int keyed) {
+
+    p = skip_json_ws(p + 1);
+    if(*p == close)
+        return p + 1;
+
+    while(p != NULL) {
+        if(keyed) {
+            if(NULL == (p = check_json_string(skip_json_ws(p))))
+                return NULL;
+            p = skip_json_ws(p);
+            if(*p++ != ':')
+                return NULL;
+        }
+        if(NULL == (p = check_json_value(p)))
+            return NULL;
+        p = skip_json_ws(p);
+        if(*p == close)
+            return p + 1;
+        if(*p++ != ',')
+            return NULL;
+    }
+    return NULL;
+}
+
+static const char* check_json_value(const char* p) {
+
+    p = skip_json_ws(p);
+    switch(*p) {
+        case '{': return check_json_list(p, '}', 1);
+        case '[': return check_json_list(p, ']', 0);
+        case '"': return check_json_string(p);
+        case 't': return strncmp(p, "true", 4)? NULL: p + 4;
+        case 'f': return strncmp(p, "false", 5)? NULL: p + 5;
+        case 'n': return strncmp(p, "null", 4)? NULL: p + 4;
+        default:
+            if(*p != '-' && !isdigit((unsigned char)*p))
+                return NULL;
+            p++;
+            while(*p != '\0' && strchr("0123456789.eE+-", *p) != NULL)
+                p++;
+            return p;
+    }
+}
+
+static int is_json(const char* text) {
+
+    const char* end = check_json_value(text);
+    return end != NULL && *skip_json_ws(end) == '\0';
+}
+
+static void check_text(const char* what, const char* got, const char* expect) {
+
+    if(strcmp(got, expect)) {
+        printf("%s:\n  got      %s\n  expected %s\n", what, got, expect);
+        failed++;
+    }
+}
+
+// read everything that was written to the fd since it was opened.
+static Buffer* read_back(FILE* fp) {
+
+    Buffer* buf = create_buffer(NULL, 0);
+    char tmp[4096];
+    size_t n;
+
+    fflush(fp);
+    rewind(fp);
+    while(0 < (n = fread(tmp, 1, sizeof(tmp), fp)))
+        append_buffer(buf, tmp, n);
+    return buf;
+}
+
+int main() {
+
+    init_cmdline("intro", "outtro", "prog", "1.2");
+    add_cmdline('v', "verbose", "verbose", "say \"more\"\tabout it\n", NULL, NULL, CMD_NARG);
+    add_cmdline('n', NULL, "count", "how many\x01", "12", NULL, CMD_NUM|CMD_RARG|CMD_REQD);
+    add_cmdline(0, "file", "file", "back\\slash", NULL, NULL, CMD_STR|CMD_LIST|CMD_OARG);
+
+    Buffer* out = create_buffer(NULL, 0);
+    export_spec_json(out);
+    check_text("small spec", raw_string(out),
+        "{\"name\":\"prog\",\"version\":\"1.2\",\"subcommand\":null,\"options\":["
+        "{\"name\":\"verbose\",\"short\":\"v\",\"long\":\"verbose\",\"type\":\"none\","
+        "\"list\":false,\"required\":false,\"arg\":\"none\",\"default\":null,"
+        "\"help\":\"say \\\"more\\\"\\tabout it\\n\"},"
+        "{\"name\":\"count\",\"short\":\"n\",\"long\":null,\"type\":\"number\","
+        "\"list\":false,\"required\":true,\"arg\":\"required\",\"default\":\"12\","
+        "\"help\":\"how many\\u0001\"},"
+        "{\"name\":\"file\",\"short\":null,\"long\":\"file\",\"type\":\"string\","
+        "\"list\":true,\"required\":false,\"arg\":\"optional\",\"default\":null,"
+        "\"help\":\"back\\\\slash\"}"
+        "],\"subcommands\":[]}\n");
+    if(!is_json(raw_string(out))) {
+        printf("small spec is not valid JSON\n");
+        failed++;
+    }
+    uninit_cmdline();
+
+    // enough options that the fd output is written in several chunks
+    char name[32], help[128];
+    init_cmdline("intro", "outtro", "prog", "1.2");
+    for(int i = 0; i < 1500; i++) {
+        snprintf(name, sizeof(name), "opt-%d", i);
+        snprintf(help, sizeof(help), "option number %d, which has a \"quoted\" word and a\ttab", i);
+        add_cmdline(0, name, name, help, (i & 1)? "dflt": NULL, NULL, CMD_STR|CMD_RARG);
+    }
+
+    clear_buffer(out);
+    export_spec_json(out);
+    if(out->length <= CHUNK_SIZE) {
+        printf("large spec is only %lu bytes\n", out->length);
+        failed++;
+    }
+    if(!is_json(raw_string(out))) {
+        printf("large spec is not valid JSON\n");
+        failed++;
+    }
+
+    FILE* fp = tmpfile();
+    if(export_spec_json_fd(fileno(fp)) != 0) {
+        printf("writing the large spec failed\n");
+        failed++;
+    }
+    Buffer* back = read_back(fp);
+    fclose(fp);
+    if(back->length != out->length || memcmp(back->buffer, out->buffer, out->length)) {
+        printf("large spec through the fd does not match the buffer\n");
+        failed++;
+    }
+    printf("large spec: %lu bytes\n", back->length);
+
+    destroy_buffer(back);
+    destroy_buffer(out);
+    uninit_cmdline();
+
+    // names that are not valid shell variables, or that collide once fixed
+    init_cmdline("intro", "outtro", "prog", "1.2");
+    add_cmdline(0, "foo-bar", "foo-bar", "help", "x", NULL, CMD_STR|CMD_RARG);
+    add_cmdline(0, "foo_bar", "foo_bar", "help", "it's", NULL, CMD_STR|CMD_RARG);
+    add_cmdline(0, "foo_bar_2", "foo_bar_2", "help", NULL, NULL, CMD_STR|CMD_RARG);
+    add_cmdline(0, "2fast", "2fast", "help", NULL, NULL, CMD_NARG);
+    add_cmdline(0, "list", "list", "help", "a,b", NULL, CMD_STR|CMD_LIST|CMD_RARG);
+
+    out = create_buffer(NULL, 0);
+    export_values(out, EXPORT_SHELL);
+    check_text("shell names", raw_string(out),
+        "foo_bar='x'  # default\n"
+        "foo_bar_3='it'\\''s'  # default\n"
+        "foo_bar_2=  # unset\n"
+        "_2fast=false  # unset\n"
+        "list=('a,b')  # default\n");
+
+    clear_buffer(out);
+    export_values(out, EXPORT_JSON);
+    check_text("json values", raw_string(out),
+        "[{\"name\":\"foo-bar\",\"source\":\"default\",\"value\":\"x\"},"
+        "{\"name\":\"foo_bar\",\"source\":\"default\",\"value\":\"it's\"},"
+        "{\"name\":\"foo_bar_2\",\"source\":\"unset\",\"value\":null},"
+        "{\"name\":\"2fast\",\"source\":\"unset\",\"value\":false},"
+        "{\"name\":\"list\",\"source\":\"default\",\"value\":[\"a,b\"]}]\n");
+    destroy_buffer(out);
+    uninit_cmdline();
+
+    if(failed) {
+        printf("FAILED: %d checks\n", failed);
+        return 1;
+    }
+
+    printf("finished\n");
+    return 0;
+}
+
+#endif
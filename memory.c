@@ -17,6 +17,7 @@
 #include <assert.h>
 
 #include "myassert.h"
+#include "stats.h"
 
 /**
  * @brief Allocate memory using malloc() and check for errors.
@@ -26,6 +27,7 @@
  */
 void* mem_alloc(size_t size) {
 
+    STAT_INC(allocs);
     void* ptr = malloc(size);
     ASSERT_MSG(ptr != NULL, "cannot allocate %lu bytes", size);
 
@@ -42,6 +44,7 @@ void* mem_alloc(size_t size) {
  */
 void* mem_realloc(void* ptr, size_t size) {
 
+    STAT_INC(reallocs);
     void* nptr = realloc(ptr, size);
     ASSERT_MSG(nptr != NULL, "cannot reallocate %lu bytes", size);
 
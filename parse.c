@@ -20,6 +20,8 @@
 #include "parse.h"
 #include "errors.h"
 #include "cmdline.h"
+#include "suggest.h"
+#include "stats.h"
 
 #define EOI 1
 #define EOS 0
@@ -29,18 +31,25 @@ static _cmdline_t_* cmdline;
 _cmdline_t_* _get_cmdline_();
 _cmd_opt_t_* search_short(int c);
 _cmd_opt_t_* search_long(const char* opt);
+Trie* get_long_trie();
 _cmd_opt_t_* search_name(const char* name);
 _cmd_opt_t_* search_no_name();
+_subcmd_t_* search_subcmd(const char* name);
+void select_subcmd(_subcmd_t_* sub);
 
 typedef struct {
     int argc;
     char** argv;
     int aidx;
     int sidx;
+    size_t alen;    // length of argv[aidx], so it is only measured once
 } _parser_t_;
 
 static _parser_t_* parser;
 
+// the characters that make up an option name or argument
+static ByteSet word_set;
+
 // return the current character
 static int get_char() {
 
@@ -58,6 +67,7 @@ static int consume_char() {
     else if(parser->argv[parser->aidx][parser->sidx] == 0) {
         parser->aidx++;
         parser->sidx = 0;
+        parser->alen = (parser->aidx < parser->argc)? strlen(parser->argv[parser->aidx]): 0;
         return get_char(); // returns EOS
     }
     else {
@@ -98,6 +108,14 @@ static void init_parser(int argc, char** argv) {
     parser->argv = argv;
     parser->aidx = 1;
     parser->sidx = 0;
+    parser->alen = (argc > 1)? strlen(argv[1]): 0;
+
+    // printable ASCII that is not a token, as isprint() is in the C locale
+    init_byte_set(&word_set);
+    add_byte_set(&word_set, ' ', '~');
+    remove_byte_set(&word_set, '=', '=');
+    remove_byte_set(&word_set, ':', ':');
+    remove_byte_set(&word_set, ',', ',');
 
     // get the data structure pointer from cmdline.c
     cmdline = _get_cmdline_();
@@ -107,16 +125,16 @@ static void init_parser(int argc, char** argv) {
 int read_word(String* str) {
 
     clear_string(str);
-    int count = 0;
+    if(parser->aidx >= parser->argc)
+        return 0;
 
-    int ch = get_char();
-    while(isprint(ch) && !is_a_token(ch)) {
-        append_string_char(str, ch);
-        ch = consume_char();
-        count++;
-    }
+    // the word is the run of word characters at the front of what is left
+    const unsigned char* ptr = (const unsigned char*)&parser->argv[parser->aidx][parser->sidx];
+    size_t count = skip_byte_set(ptr, parser->alen - parser->sidx, &word_set);
+    append_buffer(str, (void*)ptr, count);
+    parser->sidx += count;
 
-    return count;
+    return (int)count;
 }
 
 // when this is entered, the short options are an array of characters.
@@ -131,6 +149,7 @@ static int parse_short() {
     
     while(!finished) {
         ch = get_char();
+        STAT_INC(short_states);
         switch(state) {
             case 0:
                 // initial state;
@@ -151,10 +170,10 @@ static int parse_short() {
                         consume_char();
                     }
                     else
-                        error("unknown short command option: '%s'", crnt_opt());
+                        diag(DIAG_ERROR, DIAG_UNKNOWN, "unknown short command option: '%s'", crnt_opt());
                 }
                 else 
-                    error("expected a short option in '%s', but got '%c'", crnt_opt(), ch);
+                    diag(DIAG_ERROR, DIAG_SYNTAX, "expected a short option in '%s', but got '%c'", crnt_opt(), ch);
                 break;
 
             case 1:
@@ -176,10 +195,10 @@ static int parse_short() {
                     else if(ch == EOS)
                         state = 100;
                     else
-                        error("unknown short command option: '%s'", crnt_opt());
+                        diag(DIAG_ERROR, DIAG_UNKNOWN, "unknown short command option: '%s'", crnt_opt());
                 }
                 else 
-                    error("expected a short command option in '%s', but got '%c'", crnt_opt(), ch);
+                    diag(DIAG_ERROR, DIAG_SYNTAX, "expected a short command option in '%s', but got '%c'", crnt_opt(), ch);
                 break;
 
             case 2:
@@ -189,7 +208,7 @@ static int parse_short() {
                     state = 4;
                 }
                 else 
-                    error("command option '%s' requires an argument.", crnt_opt());
+                    diag(DIAG_ERROR, DIAG_MISSING, "command option '%s' requires an argument.", crnt_opt());
                 break;
 
             case 3:
@@ -211,14 +230,14 @@ static int parse_short() {
                     }
                     else {
                         if(opt->flag & CMD_SEEN)
-                            warning("duplicate option value being replaced: %s", crnt_opt());
+                            diag(DIAG_WARNING, DIAG_DUPLICATE, "duplicate option value being replaced: %s", crnt_opt());
                         clear_str_lst(opt->values);
                         append_str_lst(opt->values, copy_string(str));
                         state = 6;
                     }
                 }
                 else 
-                    error("expected an option argument in '%s', but got a %c", crnt_opt(), ch);
+                    diag(DIAG_ERROR, DIAG_SYNTAX, "expected an option argument in '%s', but got a %c", crnt_opt(), ch);
                 break;
 
             case 5:
@@ -233,13 +252,13 @@ static int parse_short() {
                     state = 100;
                 }
                 else
-                    error("unexpected character in command argument '%s': '%c'", crnt_opt(), ch);
+                    diag(DIAG_ERROR, DIAG_SYNTAX, "unexpected character in command argument '%s': '%c'", crnt_opt(), ch);
                 break;
 
             case 6:
                 // verify EOS
                 if(ch != EOS)
-                    error("unexpected character following command option '%s': %c", crnt_opt(), ch);
+                    diag(DIAG_ERROR, DIAG_SYNTAX, "unexpected character following command option '%s': %c", crnt_opt(), ch);
                 else {
                     opt->flag |= CMD_SEEN;
                     state = 100;
@@ -261,6 +280,12 @@ static int parse_short() {
     return 0;
 }
 
+// add an option to the list of candidates for an ambiguous abbreviation.
+static void list_candidate(void* data, void* ctx) {
+
+    append_string_fmt((String*)ctx, " --%s", ((_cmd_opt_t_*)data)->long_opt);
+}
+
 static int parse_long() {
 
     // read long name    
@@ -278,6 +303,7 @@ static int parse_long() {
 
         while(!finished) {
             ch = get_char();
+            STAT_INC(long_states);
             switch(state) {
                 case 0:
                     // see if there is supposed to be an arg
@@ -297,7 +323,7 @@ static int parse_long() {
                         state = 4;
                     }
                     else 
-                        error("expected an argument for command option: %s", raw_string(str));
+                        diag(DIAG_ERROR, DIAG_MISSING, "expected an argument for command option: %s", opt->long_opt);
                     break;
 
                 case 2:
@@ -311,13 +337,13 @@ static int parse_long() {
                         state = 100;
                     }
                     else 
-                        error("unexpected character following command option '%s': %c", crnt_opt(), ch);
+                        diag(DIAG_ERROR, DIAG_SYNTAX, "unexpected character following command option '%s': %c", crnt_opt(), ch);
                     break;
 
                 case 3:
                     // make sure no arg is present
                     if(ch != EOS)
-                        error("unexpected character following command option '%s': %c", crnt_opt(), ch);
+                        diag(DIAG_ERROR, DIAG_SYNTAX, "unexpected character following command option '%s': %c", crnt_opt(), ch);
                     else {
                         state = 100;
                     }
@@ -332,14 +358,14 @@ static int parse_long() {
                         }
                         else {
                             if(opt->flag & CMD_SEEN)
-                                warning("duplicate option value being replaced: %s", crnt_opt());
+                                diag(DIAG_WARNING, DIAG_DUPLICATE, "duplicate option value being replaced: %s", crnt_opt());
                             clear_str_lst(opt->values);
                             append_str_lst(opt->values, copy_string(str));
                             state = 3;
                         }
                     }
                     else 
-                        error("expected an option argument, but got a %c in '%s'", ch, crnt_opt());
+                        diag(DIAG_ERROR, DIAG_SYNTAX, "expected an option argument, but got a %c in '%s'", ch, crnt_opt());
                     break;
 
                 case 5:
@@ -353,7 +379,7 @@ static int parse_long() {
                         state = 100;
                     }
                     else
-                        error("unexpected character in command argument '%s': %c", crnt_opt(), ch);
+                        diag(DIAG_ERROR, DIAG_SYNTAX, "unexpected character in command argument '%s': %c", crnt_opt(), ch);
                     break;
 
                 case 100:
@@ -369,8 +395,32 @@ static int parse_long() {
             }
         }
     }
-    else
-        error("unknown command line option: %s", raw_string(str));
+    else {
+        TrieNode* node = NULL;
+        if(str->length > 0)
+            node = prefix_trie(get_long_trie(), raw_string(str), str->length);
+
+        if(node != NULL && node->count > 1) {
+            String* lst = create_string(NULL);
+            iterate_trie(node, list_candidate, lst);
+            diag(DIAG_ERROR, DIAG_UNKNOWN, "ambiguous command line option: --%s could be:%s", raw_string(str), raw_string(lst));
+            destroy_string(lst);
+        }
+        else {
+            _cmd_opt_t_* sug[MAX_SUGGEST];
+            int count = suggest_long(raw_string(str), sug, MAX_SUGGEST);
+            if(count > 0) {
+                String* lst = create_string(NULL);
+                for(int i = 0; i < count; i++)
+                    list_candidate(sug[i], lst);
+                diag(DIAG_ERROR, DIAG_UNKNOWN, "unknown command line option: %s, did you mean:%s", raw_string(str), raw_string(lst));
+                destroy_string(lst);
+            }
+            else
+                diag(DIAG_ERROR, DIAG_UNKNOWN, "unknown command line option: %s", raw_string(str));
+        }
+        destroy_string(str);
+    }
 
     return 0;
 }
@@ -389,11 +439,27 @@ static int parse_word() {
         append_str_lst(opt->values, str);
     }
     else
-        error("misplaced command line argument: %s", raw_string(str));
+        diag(DIAG_ERROR, DIAG_UNKNOWN, "misplaced command line argument: %s", raw_string(str));
     
     return 0;
 }
 
+// select the subcommand and let it register its options.
+static int parse_subcmd() {
+
+    String* str = create_string(NULL);
+    read_word(str);
+
+    _subcmd_t_* sub = search_subcmd(raw_string(str));
+    if(sub != NULL)
+        select_subcmd(sub);
+    else
+        diag(DIAG_ERROR, DIAG_UNKNOWN, "unknown command: %s", raw_string(str));
+
+    destroy_string(str);
+    return 0;
+}
+
 void internal_parse_cmdline(int argc, char** argv) {
 
     init_parser(argc, argv);
@@ -411,14 +477,18 @@ void internal_parse_cmdline(int argc, char** argv) {
                     consume_char();
                     state = 1;
                 }
-                else if(!is_a_token(ch)) 
-                    state = parse_word();
+                else if(!is_a_token(ch)) {
+                    if(cmdline->subcmd == NULL && cmdline->subcmds->len > 0)
+                        state = parse_subcmd();
+                    else
+                        state = parse_word();
+                }
                 else if(ch == EOS)
                     consume_char();
                 else if(ch == EOI)
                     state = 100;
                 else 
-                    error("expected a command option in '%s', but got '%c'", crnt_opt(), ch);
+                    diag(DIAG_ERROR, DIAG_SYNTAX, "expected a command option in '%s', but got '%c'", crnt_opt(), ch);
                     // does not return
                 break;
 
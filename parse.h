@@ -14,6 +14,8 @@
 
 #include "buffer.h"
 #include "str.h"
+#include "trie.h"
+#include "trace.h"
 
 typedef void (*cmdline_callback)();
 
@@ -22,11 +24,37 @@ typedef struct {
     const char* long_opt;
     const char* name;
     const char* help;
+    const char* def_val;    // NULL if there is no default
     StrLst* values;
     int flag; 
     cmdline_callback callback;
 } _cmd_opt_t_;
 
+typedef struct {
+    const char* name;
+    const char* help;
+    cmdline_callback callback;
+} _subcmd_t_;
+
+/*
+ * Read-only image of the registry that is created by freeze_cmdline(). The 
+ * whole thing lives in a single allocation. The options are sorted by name 
+ * and the values for each option are a run in the values array.
+ */
+typedef struct {
+    const char* name;
+    int flag;
+    int first;  // index of the first value in the values array
+    int count;  // number of values that belong to this option
+} _frozen_opt_t_;
+
+typedef struct {
+    size_t size;    // total bytes in the block, including this header
+    int nopts;
+    const _frozen_opt_t_* opts;
+    const char* const* values;
+} _frozen_t_;
+
 typedef struct {
     const char* prog;
     const char* name;
@@ -37,6 +65,13 @@ typedef struct {
     String* sopts; 
     int flag;
     int min_reqd;
+    PtrLst* subcmds;
+    _subcmd_t_* subcmd; // the selected subcommand, if any
+    int nglobal;        // options registered before the subcommand was selected
+    Trie* long_trie;    // long names, built on demand
+    String* help;       // rendered help text, built on demand
+    _frozen_t_* frozen;
+    uint64_t reg_start; // start of the registration phase, for the trace
 } _cmdline_t_;
 
 void internal_parse_cmdline(int argc, char** argv);
@@ -17,6 +17,7 @@
 #include "ptr_lst.h"
 #include "memory.h"
 #include "myassert.h"
+#include "stats.h"
 
 /**
  * @brief This returns a positive integer that represents the actual index 
@@ -46,6 +47,7 @@ static inline void grow_list(PtrLst* lst) {
 
     if(lst->len + 1 >= lst->cap) {
         lst->cap <<= 1;
+        STAT_INC(list_grows);
         lst->list = _REALLOC_DS_ARRAY(lst->list, void*, lst->cap);
     }
 }
@@ -0,0 +1,66 @@
+/**
+ * @file stats.c
+ * 
+ * @brief Access to the instrumentation counters. See stats.h.
+ * 
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-18
+ * @copyright Copyright (c) 2024
+ * 
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "stats.h"
+
+#ifdef USE_STATS
+_Thread_local CmdStats cmd_stats;
+#else
+static const CmdStats cmd_stats;
+#endif
+
+/**
+ * @brief Return the counters for the calling thread. They are all zero if 
+ * the library was not built with USE_STATS.
+ * 
+ * @return const CmdStats* 
+ */
+const CmdStats* get_cmdline_stats() {
+
+    return &cmd_stats;
+}
+
+/**
+ * @brief Reset the counters for the calling thread.
+ * 
+ */
+void clear_cmdline_stats() {
+
+#ifdef USE_STATS
+    memset(&cmd_stats, 0, sizeof(cmd_stats));
+#endif
+}
+
+/**
+ * @brief Print the counters for the calling thread.
+ * 
+ * @param fp 
+ */
+void print_cmdline_stats(FILE* fp) {
+
+#ifdef USE_STATS
+    fprintf(fp, "lookups:        %lu\n", cmd_stats.lookups);
+    fprintf(fp, "  scanned:      %lu\n", cmd_stats.lookup_scans);
+    fprintf(fp, "short states:   %lu\n", cmd_stats.short_states);
+    fprintf(fp, "long states:    %lu\n", cmd_stats.long_states);
+    fprintf(fp, "buffer grows:   %lu\n", cmd_stats.buffer_grows);
+    fprintf(fp, "list grows:     %lu\n", cmd_stats.list_grows);
+    fprintf(fp, "bytes copied:   %lu\n", cmd_stats.bytes_copied);
+    fprintf(fp, "allocs:         %lu\n", cmd_stats.allocs);
+    fprintf(fp, "reallocs:       %lu\n", cmd_stats.reallocs);
+    fprintf(fp, "pool hits:      %lu\n", cmd_stats.pool_hits);
+#else
+    fprintf(fp, "statistics are not enabled, build with -DUSE_STATS\n");
+#endif
+}
@@ -0,0 +1,51 @@
+/**
+ * @file stats.h
+ * 
+ * @brief Instrumentation counters for the parser and the containers. These 
+ * are only compiled in when USE_STATS is defined. Otherwise the macros 
+ * disappear from the code, the same as the asserts. The counters are per 
+ * thread, so counting is a plain increment.
+ * 
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-18
+ * @copyright Copyright (c) 2024
+ * 
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+
+typedef struct {
+    unsigned long lookups;          // option searches of any kind
+    unsigned long lookup_scans;     // entries or trie nodes examined by them
+    unsigned long short_states;     // state transitions in parse_short()
+    unsigned long long_states;      // state transitions in parse_long()
+    unsigned long buffer_grows;     // reallocations of a Buffer
+    unsigned long list_grows;       // reallocations of a PtrLst
+    unsigned long bytes_copied;     // bytes moved by the Buffer routines
+    unsigned long allocs;           // calls to mem_alloc()
+    unsigned long reallocs;         // calls to mem_realloc()
+    unsigned long pool_hits;        // Buffers and stores reused from the pool
+} CmdStats;
+
+#ifdef USE_STATS
+
+extern _Thread_local CmdStats cmd_stats;
+
+#define STAT_INC(f)     (cmd_stats.f++)
+#define STAT_ADD(f, n)  (cmd_stats.f += (n))
+
+#else
+
+#define STAT_INC(f)
+#define STAT_ADD(f, n)
+
+#endif
+
+const CmdStats* get_cmdline_stats();
+void clear_cmdline_stats();
+void print_cmdline_stats(FILE* fp);
+
+#endif  /* _STATS_H_ */
@@ -13,12 +13,83 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <string.h>
-#include <ctype.h>
 
 #include "buffer.h"
 #include "memory.h"
+#include "myassert.h"
+#include "stats.h"
 #include "str.h"
 
+/**
+ * @brief Format into tmp if the result fits, otherwise into an allocated 
+ * block. The caller frees the result if it is not tmp.
+ * 
+ * @param tmp 
+ * @param size 
+ * @param len 
+ * @param fmt 
+ * @param args 
+ * @return char* 
+ */
+static char* format_temp(char* tmp, size_t size, size_t* len, const char* fmt, va_list args) {
+
+    va_list copy;
+
+    va_copy(copy, args);
+    int n = vsnprintf(tmp, size, fmt, copy);
+    va_end(copy);
+
+    if(n < 0) {
+        tmp[0] = '\0';
+        n = 0;
+    }
+    *len = n;
+
+    if((size_t)n < size)
+        return tmp;
+
+    char* b = _ALLOC(n + 1);
+    vsnprintf(b, n + 1, fmt, args);
+    return b;
+}
+
+/**
+ * @brief Copy one piece of a join to dst, after the separator unless it is 
+ * the first one, and return where the next one goes.
+ * 
+ * @param dst 
+ * @param piece 
+ * @param len 
+ * @param sep 
+ * @param slen 
+ * @param idx 
+ * @return unsigned char* 
+ */
+static inline unsigned char* put_piece(unsigned char* dst, const void* piece, size_t len, 
+                                       const char* sep, size_t slen, int idx) {
+
+    if(idx > 0) {
+        memcpy(dst, sep, slen);
+        dst += slen;
+    }
+    memcpy(dst, piece, len);
+    return dst + len;
+}
+
+/**
+ * @brief Set the length of a join from where the last piece ended, and 
+ * terminate it.
+ * 
+ * @param s 
+ * @param end 
+ */
+static inline void finish_join(String* s, unsigned char* end) {
+
+    s->length = end - s->buffer;
+    s->buffer[s->length] = '\0';
+    STAT_ADD(bytes_copied, s->length);
+}
+
 /**
  * @brief Create a string object. Allocate memory for a dynamic string.
  * 
@@ -33,6 +104,52 @@ String* create_string(const char* str) {
         return create_buffer(NULL, 0);
 }
 
+/**
+ * @brief Create a string that refers to str instead of copying it. The 
+ * characters must stay valid while the string is in use. They are copied 
+ * the first time that the string is changed.
+ * 
+ * @param str 
+ * @return String* 
+ */
+String* view_string(const char* str) {
+
+    return view_buffer(str, strlen(str));
+}
+
+/**
+ * @brief Create an empty string that can hold size characters without 
+ * growing.
+ * 
+ * @param size 
+ * @return String* 
+ */
+String* create_string_size(size_t size) {
+
+    return create_buffer_size(size);
+}
+
+/**
+ * @brief Make sure that the string can hold size characters without growing.
+ * 
+ * @param str 
+ * @param size 
+ */
+void reserve_string(String* str, size_t size) {
+
+    reserve_buffer(str, size);
+}
+
+/**
+ * @brief Release the memory that the string is not using.
+ * 
+ * @param str 
+ */
+void shrink_string(String* str) {
+
+    shrink_buffer(str);
+}
+
 /**
  * @brief Free all of the memory for a dynamic string.
  * 
@@ -63,6 +180,7 @@ void append_string_str(String* ptr, const char* str) {
  */
 void append_string_string(String* ptr, String* str) {
 
+    flatten_buffer(str);
     append_buffer(ptr, str->buffer, str->length);
 }
 
@@ -78,7 +196,9 @@ void append_string_char(String* ptr, int ch) {
 }
 
 /**
- * @brief Append a const char* to the string after formatting.
+ * @brief Append a const char* to the string after formatting. The text is 
+ * formatted on the stack first, so the arguments may come from the string 
+ * itself.
  * 
  * @param ptr 
  * @param fmt 
@@ -87,18 +207,73 @@ void append_string_char(String* ptr, int ch) {
 void append_string_fmt(String* ptr, const char* fmt, ...) {
 
     va_list args;
+    char tmp[256];
+    size_t len;
 
     va_start(args, fmt);
-    size_t len = vsnprintf(NULL, 0, fmt, args);
-    va_end(args);
-
-    char* b = _ALLOC(len+1);
-    va_start(args, fmt);
-    vsprintf(b, fmt, args);
+    char* b = format_temp(tmp, sizeof(tmp), &len, fmt, args);
     va_end(args);
 
     append_buffer(ptr, (unsigned char*)b, len);
-    _FREE(b);
+    if(b != tmp)
+        _FREE(b);
+}
+
+/**
+ * @brief Append an integer in decimal.
+ * 
+ * @param ptr 
+ * @param val 
+ */
+void append_string_int(String* ptr, long long val) {
+
+    append_int_buffer(ptr, val, 0);
+}
+
+/**
+ * @brief Append an integer in hex, with leading zeros to make at least 
+ * digits digits.
+ * 
+ * @param ptr 
+ * @param val 
+ * @param digits 
+ */
+void append_string_hex(String* ptr, unsigned long long val, int digits) {
+
+    append_hex_buffer(ptr, val, digits);
+}
+
+/**
+ * @brief Append a double in the shortest form that reads back the same.
+ * 
+ * @param ptr 
+ * @param val 
+ */
+void append_string_double(String* ptr, double val) {
+
+    append_double_buffer(ptr, val);
+}
+
+/**
+ * @brief Append the str padded with spaces to width characters. A negative 
+ * width puts the padding after the str, so it is left justified. A str that 
+ * is longer than the width is not cut.
+ * 
+ * @param ptr 
+ * @param str 
+ * @param width 
+ */
+void append_string_pad(String* ptr, const char* str, int width) {
+
+    size_t len = strlen(str);
+    size_t field = (width < 0)? (size_t)-width: (size_t)width;
+    size_t pad = (field > len)? field - len: 0;
+
+    if(width > 0)
+        fill_buffer(ptr, ' ', pad);
+    append_buffer(ptr, (void*)str, len);
+    if(width < 0)
+        fill_buffer(ptr, ' ', pad);
 }
 
 /**
@@ -123,6 +298,7 @@ void insert_string_str(String* ptr, int idx, const char* str) {
  */
 void insert_string_string(String* ptr, int idx, String* str) {
 
+    flatten_buffer(str);
     insert_buffer(ptr, str->buffer, str->length, idx);
 }
 
@@ -149,18 +325,16 @@ void insert_string_char(String* ptr, int idx, int ch) {
 void insert_string_fmt(String* ptr, int idx, const char* fmt, ...) {
 
     va_list args;
+    char tmp[256];
+    size_t len;
 
     va_start(args, fmt);
-    size_t len = vsnprintf(NULL, 0, fmt, args);
-    va_end(args);
-
-    char* b = _ALLOC(len+1);
-    va_start(args, fmt);
-    vsprintf(b, fmt, args);
+    char* b = format_temp(tmp, sizeof(tmp), &len, fmt, args);
     va_end(args);
 
     insert_buffer(ptr, (unsigned char*)b, len, idx);
-    _FREE(b);
+    if(b != tmp)
+        _FREE(b);
 }
 
 /**
@@ -174,10 +348,63 @@ void insert_string_fmt(String* ptr, int idx, const char* fmt, ...) {
 void replace_string_str(String* ptr, const char* find, const char* repl) {
 
     int fnd_idx = search_string(ptr, find);
-    if(fnd_idx >= 0) {
-        clip_string(ptr, fnd_idx, fnd_idx + strlen(find));
-        insert_string_str(ptr, fnd_idx, repl);
+    if(fnd_idx >= 0)
+        splice_buffer(ptr, fnd_idx, fnd_idx + strlen(find), (void*)repl, strlen(repl));
+}
+
+/**
+ * @brief Replace every occurrence of the string, from left to right. The 
+ * result is built in one pass. Returns the number of replacements.
+ * 
+ * @param ptr 
+ * @param find 
+ * @param repl 
+ * @return int 
+ */
+int replace_all_string(String* ptr, const char* find, const char* repl) {
+
+    BufferSubst sub = { find, strlen(find), repl, strlen(repl) };
+
+    if(sub.find_len == 0)
+        return 0;
+
+    return substitute_buffer(ptr, &sub, 1);
+}
+
+/**
+ * @brief Replace every occurrence of each of the strings in find with the 
+ * string at the same index in repl, in a single pass. Where more than one 
+ * matches at the same place, the longest one is replaced. Returns the 
+ * number of replacements.
+ * 
+ * @param ptr 
+ * @param find 
+ * @param repl 
+ * @param count 
+ * @return int 
+ */
+int replace_multi_string(String* ptr, const char** find, const char** repl, int count) {
+
+    BufferSubst local[16];
+    BufferSubst* subs = (count <= 16)? local: _ALLOC_DS_ARRAY(BufferSubst, count);
+    int num = 0;
+
+    for(int i = 0; i < count; i++) {
+        if(find[i][0] != '\0') {
+            subs[num].find = find[i];
+            subs[num].find_len = strlen(find[i]);
+            subs[num].repl = repl[i];
+            subs[num].repl_len = strlen(repl[i]);
+            num++;
+        }
     }
+
+    int retv = (num > 0)? substitute_buffer(ptr, subs, num): 0;
+
+    if(subs != local)
+        _FREE(subs);
+
+    return retv;
 }
 
 /**
@@ -203,18 +430,16 @@ void replace_string_string(String* ptr, const char* find, String* repl) {
 void replace_string_fmt(String* ptr, const char* find, const char* fmt, ...) {
 
     va_list args;
+    char tmp[256];
+    size_t len;
 
     va_start(args, fmt);
-    size_t len = vsnprintf(NULL, 0, fmt, args);
-    va_end(args);
-
-    char* b = _ALLOC(len+1);
-    va_start(args, fmt);
-    vsprintf(b, fmt, args);
+    char* b = format_temp(tmp, sizeof(tmp), &len, fmt, args);
     va_end(args);
 
     replace_string_str(ptr, find, b);
-    _FREE(b);
+    if(b != tmp)
+        _FREE(b);
 }
 
 /**
@@ -224,8 +449,7 @@ void replace_string_fmt(String* ptr, const char* find, const char* fmt, ...) {
  */
 void clear_string(String* str) {
 
-    str->length = 0;
-    str->buffer[0] = '\0';
+    clear_buffer(str);
 }
 
 /**
@@ -237,34 +461,37 @@ void clear_string(String* str) {
  */
 String* copy_string(String* str) {
 
-    return create_string(raw_string(str));
+    flatten_buffer(str);
+    return create_buffer(str->buffer, str->length);
 }
 
 /**
- * @brief Convert the string to lower case.
+ * @brief Convert the ASCII letters in the string to lower case.
  * 
  * @param str 
  */
 void lower_string(String* str) {
 
-    for(size_t i = 0; i < str->length; i++)
-        str->buffer[i] = tolower(str->buffer[i]);
+    own_buffer(str);
+    flatten_buffer(str);
+    lower_bytes(str->buffer, str->length);
 }
 
 /**
- * @brief Convert the string to upper case.
+ * @brief Convert the ASCII letters in the string to upper case.
  * 
  * @param str 
  */
 void upper_string(String* str) {
 
-    for(size_t i = 0; i < str->length; i++)
-        str->buffer[i] = toupper(str->buffer[i]);
+    own_buffer(str);
+    flatten_buffer(str);
+    upper_bytes(str->buffer, str->length);
 }
 
 /**
  * @brief Return a pointer to the string that is usable by system calls such 
- * as printf().
+ * as printf(). A view is copied first, because it may not be terminated.
  * 
  * @param str 
  * @return const char* 
@@ -272,6 +499,8 @@ void upper_string(String* str) {
 const char* raw_string(String* str) {
 
     if(str != NULL) {
+        own_buffer(str);
+        flatten_buffer(str);
         str->buffer[str->length] = '\0';
         return (const char*)str->buffer;
     }
@@ -279,6 +508,28 @@ const char* raw_string(String* str) {
         return NULL;
 }
 
+/**
+ * @brief Return a pointer to the characters of the string and store the 
+ * length in len. The characters are not changed, so this works on views, 
+ * but they are not always NUL terminated.
+ * 
+ * @param str 
+ * @param len 
+ * @return const char* 
+ */
+const char* peek_string(String* str, size_t* len) {
+
+    if(str != NULL) {
+        flatten_buffer(str);
+        *len = str->length;
+        return (const char*)str->buffer;
+    }
+    else {
+        *len = 0;
+        return NULL;
+    }
+}
+
 /**
  * @brief Delete the part of the string that is between the start and the end 
  * indexes.
@@ -320,17 +571,100 @@ int iterate_string(String* str, int* post) {
  */
 StrLst* split_string(String* str, const char* mark) {
 
-    int post = 0;
+    Tokenizer tok;
+    StrSlice slice;
     StrLst* lst = create_str_lst();
-    const char* tmp;
 
-    while(NULL != (tmp = tokenize_string(str, &post, mark))) {
-        append_str_lst(lst, create_string(tmp));
-    }
+    init_tokenizer(&tok, str, mark, 0);
+    while(next_token(&tok, &slice))
+        append_str_lst(lst, create_buffer((void*)slice.str, slice.len));
 
     return lst;
 }
 
+/**
+ * @brief Split the string into fields, as next_token() finds them, and 
+ * return them as an array of slices in a single allocation. The slices 
+ * point into the string, so it must not change while they are in use, 
+ * unless TOK_COPY is given. Then a copy of the string is kept in the same 
+ * allocation and the slices point into that.
+ * 
+ * @param str 
+ * @param mark 
+ * @param flags 
+ * @return StrSplit* 
+ */
+StrSplit* split_slices(String* str, const char* mark, int flags) {
+
+    Tokenizer tok;
+    StrSlice slice;
+    int count = 0;
+
+    // count the fields first so the array is the right size
+    init_tokenizer(&tok, str, mark, flags);
+    while(next_token(&tok, &slice))
+        count++;
+
+    size_t size = sizeof(StrSplit) + count * sizeof(StrSlice);
+    if(flags & TOK_COPY)
+        size += tok.len + 1;
+
+    StrSplit* split = _ALLOC(size);
+    const char* base = tok.ptr;
+    if(flags & TOK_COPY) {
+        char* copy = (char*)&split->slices[count];
+        memcpy(copy, tok.ptr, tok.len);
+        copy[tok.len] = '\0';
+        base = copy;
+    }
+
+    split->count = 0;
+    init_tokenizer(&tok, str, mark, flags);
+    while(next_token(&tok, &slice)) {
+        slice.str = base + (slice.str - tok.ptr);
+        split->slices[split->count++] = slice;
+    }
+
+    return split;
+}
+
+/**
+ * @brief Free the slices returned by split_slices().
+ * 
+ * @param split 
+ */
+void destroy_split(StrSplit* split) {
+
+    if(split != NULL)
+        _FREE(split);
+}
+
+/**
+ * @brief Call func for each field of the string, as next_token() finds 
+ * them, and return the number of fields. Nothing is allocated.
+ * 
+ * @param str 
+ * @param mark 
+ * @param flags 
+ * @param func 
+ * @param ctx 
+ * @return int 
+ */
+int visit_split(String* str, const char* mark, int flags, split_visitor func, void* ctx) {
+
+    Tokenizer tok;
+    StrSlice slice;
+    int count = 0;
+
+    init_tokenizer(&tok, str, mark, flags);
+    while(next_token(&tok, &slice)) {
+        (*func)(&slice, ctx);
+        count++;
+    }
+
+    return count;
+}
+
 /**
  * @brief Join an array of strings where the given str is between them.
  * 
@@ -341,26 +675,86 @@ StrLst* split_string(String* str, const char* mark) {
 String* join_string(StrLst* lst, const char* str) {
 
     int post = 0;
-    String* s = create_string(NULL);
     String* tmp;
 
-    tmp = iterate_str_lst(lst, &post);
-    while(tmp != NULL) {
-        append_string_string(s, tmp);
-        tmp = iterate_str_lst(lst, &post);
-        if(tmp != NULL)
-            append_string_str(s, str);
+    // size the result first so it is built without growing
+    size_t total = 0;
+    size_t slen = strlen(str);
+    while(NULL != (tmp = iterate_str_lst(lst, &post))) {
+        flatten_buffer(tmp);
+        total += tmp->length + slen;
     }
 
+    String* s = create_string_size((total > slen)? total - slen: 0);
+    unsigned char* dst = s->buffer;
+
+    post = 0;
+    for(int i = 0; NULL != (tmp = iterate_str_lst(lst, &post)); i++)
+        dst = put_piece(dst, tmp->buffer, tmp->length, str, slen, i);
+
+    finish_join(s, dst);
+    return s;
+}
+
+/**
+ * @brief Join an array of count C strings with str between them. The 
+ * result is allocated once, at its final size.
+ * 
+ * @param arr 
+ * @param count 
+ * @param str 
+ * @return String* 
+ */
+String* join_str_array(const char** arr, int count, const char* str) {
+
+    size_t total = 0;
+    size_t slen = strlen(str);
+    for(int i = 0; i < count; i++)
+        total += strlen(arr[i]) + slen;
+
+    String* s = create_string_size((total > slen)? total - slen: 0);
+    unsigned char* dst = s->buffer;
+
+    for(int i = 0; i < count; i++)
+        dst = put_piece(dst, arr[i], strlen(arr[i]), str, slen, i);
+
+    finish_join(s, dst);
+    return s;
+}
+
+/**
+ * @brief Join an array of count slices with str between them. The result 
+ * is allocated once, at its final size.
+ * 
+ * @param slices 
+ * @param count 
+ * @param str 
+ * @return String* 
+ */
+String* join_slices(const StrSlice* slices, int count, const char* str) {
+
+    size_t total = 0;
+    size_t slen = strlen(str);
+    for(int i = 0; i < count; i++)
+        total += slices[i].len + slen;
+
+    String* s = create_string_size((total > slen)? total - slen: 0);
+    unsigned char* dst = s->buffer;
+
+    for(int i = 0; i < count; i++)
+        dst = put_piece(dst, slices[i].str, slices[i].len, str, slen, i);
+
+    finish_join(s, dst);
     return s;
 }
 
 /**
  * @brief Return successive tokens from the string, similar to strtok(). On 
- * the first call, post must point to 0. That resets strtok so that it begins 
- * in the string. This function allocates a buffer to operate on so that the 
- * original string does not need to be writable. Uses strtok() to tokenize 
- * the string.
+ * the first call, post must point to 0. The string is not changed. Each 
+ * token is copied so that it can be terminated, and the pointer is only 
+ * good until the next call. The state is kept per thread, so only one 
+ * tokenization can be in progress in each thread. Use a Tokenizer to avoid 
+ * both of those limits and the copy.
  * 
  * @param str 
  * @param post 
@@ -369,20 +763,106 @@ String* join_string(StrLst* lst, const char* str) {
  */
 const char* tokenize_string(String* str, int* post, const char* mark) {
 
-    static const char* ptr = NULL;
-    const char* retv;
+    static _Thread_local Tokenizer tok;
+    static _Thread_local String* token = NULL;
+    StrSlice slice;
 
     if(*post == 0) {
-        if(ptr != NULL)
-            _FREE(ptr);
-        ptr = _COPY_STR((const char*)str->buffer);
+        init_tokenizer(&tok, str, mark, 0);
         *post = 1;
-        retv = strtok((char*)ptr, mark);
     }
-    else
-        retv = strtok(NULL, mark);
 
-    return retv;
+    if(!next_token(&tok, &slice)) {
+        destroy_string(token);
+        token = NULL;
+        return NULL;
+    }
+
+    if(token == NULL)
+        token = create_string(NULL);
+    clear_string(token);
+    append_buffer(token, (void*)slice.str, slice.len);
+
+    return (const char*)token->buffer;
+}
+
+/**
+ * @brief Set up a tokenizer over the string. By default every character in 
+ * mark is a delimiter and runs of them are skipped, as with strtok(). With 
+ * TOK_WHOLE_MARK the whole of mark is a single delimiter and with 
+ * TOK_KEEP_EMPTY the empty fields between delimiters are returned. The 
+ * string and mark must not change while the tokenizer is in use.
+ * 
+ * @param tok 
+ * @param str 
+ * @param mark 
+ * @param flags 
+ */
+void init_tokenizer(Tokenizer* tok, String* str, const char* mark, int flags) {
+
+    ASSERT(tok != NULL);
+    ASSERT(mark != NULL);
+
+    tok->ptr = peek_string(str, &tok->len);
+    tok->pos = 0;
+    tok->mark = mark;
+    tok->mark_len = strlen(mark);
+    tok->flags = flags;
+    tok->done = 0;
+
+    if(!(flags & TOK_WHOLE_MARK))
+        fill_byte_set(&tok->set, (const unsigned char*)mark, tok->mark_len);
+}
+
+/**
+ * @brief Store the next token in slice. The slice points into the string 
+ * and is not terminated. Returns 0 when there are no more tokens.
+ * 
+ * @param tok 
+ * @param slice 
+ * @return int 
+ */
+int next_token(Tokenizer* tok, StrSlice* slice) {
+
+    ASSERT(tok != NULL);
+    ASSERT(slice != NULL);
+
+    const unsigned char* base = (const unsigned char*)tok->ptr;
+    int whole = tok->flags & TOK_WHOLE_MARK;
+
+    while(!tok->done) {
+        // runs of single delimiters are passed over in one scan
+        if(!whole && !(tok->flags & TOK_KEEP_EMPTY))
+            tok->pos += skip_byte_set(&base[tok->pos], tok->len - tok->pos, &tok->set);
+
+        const unsigned char* start = &base[tok->pos];
+        size_t rest = tok->len - tok->pos;
+        size_t idx = rest;
+
+        if(whole && tok->mark_len > 0) {
+            const unsigned char* ptr = find_bytes(start, rest, 
+                                        (const unsigned char*)tok->mark, tok->mark_len);
+            if(ptr != NULL)
+                idx = ptr - start;
+        }
+        else if(!whole)
+            idx = find_byte_set(start, rest, &tok->set);
+
+        slice->str = (const char*)start;
+        slice->len = idx;
+
+        if(idx == rest) {
+            tok->done = 1;
+            tok->pos = tok->len;
+        }
+        else
+            tok->pos += idx + (whole? tok->mark_len: 1);
+
+        if(idx > 0 || (tok->flags & TOK_KEEP_EMPTY))
+            return 1;
+    }
+
+    return 0;
 }
 
 /**
@@ -398,6 +878,46 @@ int search_string(String* str, const char* srch) {
     return search_buffer(str, (void*)srch, strlen(srch));
 }
 
+/**
+ * @brief Return the index of the last occurrence of the search string, or 
+ * (<0) if it is not found.
+ * 
+ * @param str 
+ * @param srch 
+ * @return int 
+ */
+int rsearch_string(String* str, const char* srch) {
+
+    return rsearch_buffer(str, (void*)srch, strlen(srch));
+}
+
+/**
+ * @brief Return the index of each occurrence of the search string in turn. 
+ * On the first call, post must point to 0. When (*post == -1) then there 
+ * are no more and (<0) is returned.
+ * 
+ * @param str 
+ * @param srch 
+ * @param post 
+ * @return int 
+ */
+int search_all_string(String* str, const char* srch, int* post) {
+
+    return search_all_buffer(str, (void*)srch, strlen(srch), post);
+}
+
+/**
+ * @brief Return the number of times that the search string occurs.
+ * 
+ * @param str 
+ * @param srch 
+ * @return int 
+ */
+int count_string(String* str, const char* srch) {
+
+    return count_buffer(str, (void*)srch, strlen(srch));
+}
+
 /**
  * @brief Compare the String to the const char* str and return what strcmp() 
  * would find.
@@ -436,18 +956,21 @@ int comp_string_string(String* ptr, String* str) {
 int comp_string_fmt(String* ptr, const char* fmt, ...) {
 
     va_list args;
+    char tmp[256];
+    size_t len;
 
     va_start(args, fmt);
-    size_t len = vsnprintf(NULL, 0, fmt, args);
-    va_end(args);
-
-    char* b = _ALLOC(len+1);
-    va_start(args, fmt);
-    vsprintf(b, fmt, args);
+    char* b = format_temp(tmp, sizeof(tmp), &len, fmt, args);
     va_end(args);
 
-    int retv = strcmp(raw_string(ptr), b);
-    _FREE(b);
+    // the same as strcmp(), but a view does not need to be copied
+    size_t slen;
+    const char* str = peek_string(ptr, &slen);
+    int retv = memcmp(str, b, (slen < len)? slen: len);
+    if(retv == 0)
+        retv = (slen > len) - (slen < len);
+    if(b != tmp)
+        _FREE(b);
 
     return retv;
 }
@@ -577,6 +1100,19 @@ String* iterate_str_lst(StrLst* lst, int* post) {
     return (String*)iterate_ptr_lst(lst, post);
 }
 
+/**
+ * @brief Write all of the strings in the list to the fd, in order, without 
+ * joining them first. Returns 0 on success or -1 if a write failed.
+ * 
+ * @param fd 
+ * @param lst 
+ * @return int 
+ */
+int write_str_lst_fd(int fd, StrLst* lst) {
+
+    return write_buffers_fd(fd, (Buffer**)lst->list, lst->len);
+}
+
 /**
  * @brief Clear the list and free all entries, but do not destroy the list.
  * 
@@ -592,3 +1128,278 @@ void clear_str_lst(StrLst* lst) {
 
     lst->len = 0;
 }
+
+/******************************************************************************
+ *
+ * Test Code
+ *
+ */
+#ifdef TEST_STR
+
+static int failed = 0;
+
+static void check(const char* what, String* str, const char* expect) {
+
+    if(strcmp(raw_string(str), expect)) {
+        printf("%s: got '%s', expected '%s'\n", what, raw_string(str), expect);
+        failed++;
+    }
+}
+
+// the tokens of the text, each one in angle brackets.
+static void check_tokens(const char* text, const char* mark, int flags, const char* expect) {
+
+    String* str = create_string(text);
+    String* out = create_string(NULL);
+    Tokenizer tok;
+    StrSlice slice;
+
+    init_tokenizer(&tok, str, mark, flags);
+    while(next_token(&tok, &slice)) {
+        append_string_char(out, '<');
+        append_buffer(out, (void*)slice.str, slice.len);
+        append_string_char(out, '>');
+    }
+
+    char what[128];
+    snprintf(what, sizeof(what), "tokens of '%s' by '%s', flags %d", text, mark, flags);
+    check(what, out, expect);
+
+    destroy_string(out);
+    destroy_string(str);
+}
+
+// a visitor for visit_split() that adds the field to the string in ctx.
+static void add_field(const StrSlice* field, void* ctx) {
+
+    append_string_char((String*)ctx, '<');
+    append_buffer((String*)ctx, (void*)field->str, field->len);
+    append_string_char((String*)ctx, '>');
+}
+
+static void check_split(const char* what, StrSplit* split, const char* expect) {
+
+    String* out = create_string(NULL);
+    for(int i = 0; i < split->count; i++)
+        add_field(&split->slices[i], out);
+    check(what, out, expect);
+    destroy_string(out);
+}
+
+int main() {
+
+    // init_tokenizer() and next_token()
+    check_tokens("a,b,,c,", ",", 0, "<a><b><c>");
+    check_tokens(",,a,b,,c,", ",", 0, "<a><b><c>");
+    check_tokens("a,b,,c,", ",", TOK_KEEP_EMPTY, "<a><b><><c><>");
+    check_tokens(",a", ",", TOK_KEEP_EMPTY, "<><a>");
+    check_tokens("", ",", 0, "");
+    check_tokens("", ",", TOK_KEEP_EMPTY, "<>");
+    check_tokens(",,,", ",", 0, "");
+    check_tokens("  lots \tof  space ", " \t", 0, "<lots><of><space>");
+    check_tokens("one::two:three::", "::", TOK_WHOLE_MARK, "<one><two:three>");
+    check_tokens("one::two:three::", "::", TOK_WHOLE_MARK|TOK_KEEP_EMPTY, "<one><two:three><>");
+    check_tokens("::::x", "::", TOK_WHOLE_MARK, "<x>");
+    check_tokens("abc", "", 0, "<abc>");
+    check_tokens("abc", "", TOK_WHOLE_MARK, "<abc>");
+
+    // two tokenizers in use at the same time do not disturb each other
+    String* a = create_string("1 2 3");
+    String* b = create_string("x,y");
+    String* out = create_string(NULL);
+    int n;
+    Tokenizer ta, tb;
+    StrSlice sa, sb;
+    init_tokenizer(&ta, a, " ", 0);
+    init_tokenizer(&tb, b, ",", 0);
+    while(next_token(&ta, &sa)) {
+        append_buffer(out, (void*)sa.str, sa.len);
+        if(next_token(&tb, &sb))
+            append_buffer(out, (void*)sb.str, sb.len);
+        append_string_char(out, ' ');
+    }
+    check("interleaved tokenizers", out, "1x 2y 3 ");
+
+    // the old interface is built on the tokenizer
+    int post = 0;
+    const char* tok;
+    clear_string(out);
+    while(NULL != (tok = tokenize_string(a, &post, " ")))
+        append_string_fmt(out, "(%s)", tok);
+    check("tokenize_string", out, "(1)(2)(3)");
+    destroy_string(out);
+    destroy_string(a);
+    destroy_string(b);
+
+    // split_slices(), visit_split() and split_string()
+    a = create_string("red,green,,blue,");
+    StrSplit* split = split_slices(a, ",", 0);
+    check_split("split", split, "<red><green><blue>");
+    if(split->slices[1].str != (const char*)a->buffer + 4) {
+        printf("split: the slices do not point into the string\n");
+        failed++;
+    }
+    destroy_split(split);
+
+    // the copy is rebased into the block, so the string can go away
+    split = split_slices(a, ",", TOK_COPY|TOK_KEEP_EMPTY);
+    destroy_string(a);
+    check_split("split a copy", split, "<red><green><><blue><>");
+    if(split->slices[0].str != (const char*)&split->slices[split->count]) {
+        printf("split a copy: the slices do not point into the copy\n");
+        failed++;
+    }
+    destroy_split(split);
+
+    a = create_string("");
+    split = split_slices(a, ",", 0);
+    if(split->count != 0) {
+        printf("split empty: %d fields, expected 0\n", split->count);
+        failed++;
+    }
+    destroy_split(split);
+    split = split_slices(a, ",", TOK_KEEP_EMPTY|TOK_COPY);
+    check_split("split empty, keep empty", split, "<>");
+    destroy_split(split);
+    destroy_string(a);
+
+    a = create_string("k1::v1::::k2");
+    out = create_string(NULL);
+    n = visit_split(a, "::", TOK_WHOLE_MARK|TOK_KEEP_EMPTY, add_field, out);
+    check("visit", out, "<k1><v1><><k2>");
+    if(n != 4) {
+        printf("visit: %d fields, expected 4\n", n);
+        failed++;
+    }
+
+    StrLst* lst = split_string(a, ":");
+    clear_string(out);
+    post = 0;
+    String* field;
+    while(NULL != (field = iterate_str_lst(lst, &post)))
+        add_field(&(StrSlice){ raw_string(field), field->length }, out);
+    check("split_string", out, "<k1><v1><k2>");
+    destroy_str_lst(lst);
+    destroy_string(out);
+    destroy_string(a);
+
+    // join_str_array(), join_slices() and join_string()
+    const char* words[] = { "", "alpha", "", "beta" };
+    out = join_str_array(words, 0, ", ");
+    check("join nothing", out, "");
+    destroy_string(out);
+    out = join_str_array(&words[1], 1, ", ");
+    check("join one", out, "alpha");
+    destroy_string(out);
+    out = join_str_array(words, 4, ", ");
+    check("join with empty strings", out, ", alpha, , beta");
+    destroy_string(out);
+    out = join_str_array(&words[1], 3, "");
+    check("join without a separator", out, "alphabeta");
+    destroy_string(out);
+
+    a = create_string("--one --two --three --four --five --six --seven");
+    split = split_slices(a, " ", 0);
+    out = join_slices(split->slices, split->count, " ");
+    check("join slices", out, raw_string(a));
+    destroy_string(out);
+    out = join_slices(&split->slices[5], 2, "");
+    check("join two slices", out, "--six--seven");
+    destroy_string(out);
+    destroy_split(split);
+
+    lst = split_string(a, " -");
+    out = join_string(lst, "+");
+    check("join list", out, "one+two+three+four+five+six+seven");
+    destroy_string(out);
+    destroy_str_lst(lst);
+    destroy_string(a);
+
+    String* s = create_string("abc");
+
+    // the arguments point into the string that is being appended to
+    append_string_fmt(s, "%s", raw_string(s));
+    check("append itself", s, "abcabc");
+    append_string_fmt(s, "-%s-%s", raw_string(s), raw_string(s));
+    check("append itself twice", s, "abcabc-abcabc-abcabc");
+    for(int i = 0; i < 5; i++)
+        append_string_fmt(s, "%s", raw_string(s));
+    if(s->length != 20 * 32) {
+        printf("append itself past the stack buffer: length %lu\n", s->length);
+        failed++;
+    }
+    destroy_string(s);
+
+    s = create_string(NULL);
+    append_string_fmt(s, "%d %s %c", -42, "xy", 'z');
+    check("append numbers", s, "-42 xy z");
+    destroy_string(s);
+
+    // replace_all_string() and replace_multi_string()
+    const char* find[] = { "a", "ab", "abc", "" };
+    const char* repl[] = { "1", "2", "3", "X" };
+
+    s = create_string("one two one");
+    n = replace_all_string(s, "one", "three");
+    check("replace all", s, "three two three");
+    if(n != 2) {
+        printf("replace all: %d replaced, expected 2\n", n);
+        failed++;
+    }
+    destroy_string(s);
+
+    s = create_string("abcabab");
+    n = replace_multi_string(s, find, repl, 4);
+    check("longest match wins", s, "322");
+    if(n != 3) {
+        printf("longest match wins: %d replaced, expected 3\n", n);
+        failed++;
+    }
+    destroy_string(s);
+
+    s = create_string("xyz");
+    n = replace_all_string(s, "", "X") + replace_multi_string(s, &find[3], &repl[3], 1);
+    check("empty pattern is skipped", s, "xyz");
+    if(n != 0) {
+        printf("empty pattern is skipped: %d replaced, expected 0\n", n);
+        failed++;
+    }
+    destroy_string(s);
+
+    s = create_string("Bartholomew and Bartholomew, not Bart");
+    const unsigned char* store = s->buffer;
+    n = replace_all_string(s, "Bartholomew", "Bo");
+    check("shrink in place", s, "Bo and Bo, not Bart");
+    if(n != 2 || s->buffer != store) {
+        printf("shrink in place: %d replaced, store %s\n", n, (s->buffer == store)? "kept": "moved");
+        failed++;
+    }
+    destroy_string(s);
+
+    const char* text = "x-y-z";
+    s = view_string(text);
+    n = replace_all_string(s, "-", "+");
+    check("view source", s, "x+y+z");
+    if(strcmp(text, "x-y-z") || n != 2) {
+        printf("view source: '%s' changed or %d replaced\n", text, n);
+        failed++;
+    }
+    destroy_string(s);
+
+    s = create_string("cab");
+    set_buffer_gap(s, 1);
+    insert_string_str(s, 1, "ab");
+    n = replace_multi_string(s, find, repl, 4);
+    check("gap source", s, "c22");
+    destroy_string(s);
+
+    if(failed) {
+        printf("FAILED: %d checks\n", failed);
+        return 1;
+    }
+
+    printf("finished\n");
+    return 0;
+}
+
+#endif
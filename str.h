@@ -18,12 +18,53 @@
 typedef Buffer String;
 typedef PtrLst StrLst;
 
+// Part of a String. It points into the String and is not terminated.
+typedef struct {
+    const char* str;
+    size_t len;
+} StrSlice;
+
+typedef enum {
+    TOK_KEEP_EMPTY = 0x01,  // return the empty fields between delimiters
+    TOK_WHOLE_MARK = 0x02,  // the mark is one delimiter, not a set of them
+    TOK_COPY = 0x04,        // split_slices() keeps its own copy of the string
+} TokFlags;
+
+// Iteration state for next_token(), owned by the caller.
+typedef struct {
+    const char* ptr;
+    size_t len;
+    size_t pos;         // where the next token starts
+    const char* mark;
+    size_t mark_len;
+    ByteSet set;        // the delimiters, unless TOK_WHOLE_MARK is set
+    int flags;
+    int done;
+} Tokenizer;
+
+// The fields of a string, from split_slices(). This is a single block that
+// is released with destroy_split().
+typedef struct {
+    int count;
+    StrSlice slices[];
+} StrSplit;
+
+typedef void (*split_visitor)(const StrSlice* field, void* ctx);
+
 String* create_string(const char* str);
+String* create_string_size(size_t size);
+String* view_string(const char* str);
 void destroy_string(String* str);
+void reserve_string(String* str, size_t size);
+void shrink_string(String* str);
 void append_string_str(String* ptr, const char* str);
 void append_string_string(String* ptr, String* str);
 void append_string_char(String* ptr, int ch);
 void append_string_fmt(String* ptr, const char* fmt, ...);
+void append_string_int(String* ptr, long long val);
+void append_string_hex(String* ptr, unsigned long long val, int digits);
+void append_string_double(String* ptr, double val);
+void append_string_pad(String* ptr, const char* str, int width);
 
 void insert_string_str(String* ptr, int idx, const char* str);
 void insert_string_string(String* ptr, int idx, String* str);
@@ -32,6 +73,8 @@ void insert_string_fmt(String* ptr, int idx, const char* fmt, ...);
 
 void replace_string_str(String* ptr, const char* find, const char* repl);
 void replace_string_fmt(String* ptr, const char* find, const char* fmt, ...);
+int replace_all_string(String* ptr, const char* find, const char* repl);
+int replace_multi_string(String* ptr, const char** find, const char** repl, int count);
 
 void clear_string(String* str);
 void lower_string(String* str);
@@ -39,13 +82,24 @@ void upper_string(String* str);
 String* copy_string(String* str);
 
 const char* raw_string(String* str);
+const char* peek_string(String* str, size_t* len);
 const char* clip_string(String* str, int start, int end);
 int iterate_string(String* str, int* post);
 StrLst* split_string(String* str, const char* mark);
 String* join_string(StrLst* lst, const char* str);
+String* join_str_array(const char** arr, int count, const char* str);
+String* join_slices(const StrSlice* slices, int count, const char* str);
 const char* tokenize_string(String* str, int* post, const char* mark);
+void init_tokenizer(Tokenizer* tok, String* str, const char* mark, int flags);
+int next_token(Tokenizer* tok, StrSlice* slice);
+StrSplit* split_slices(String* str, const char* mark, int flags);
+void destroy_split(StrSplit* split);
+int visit_split(String* str, const char* mark, int flags, split_visitor func, void* ctx);
 
 int search_string(String* str, const char* srch);
+int rsearch_string(String* str, const char* srch);
+int search_all_string(String* str, const char* srch, int* post);
+int count_string(String* str, const char* srch);
 int comp_string_str(String* ptr, const char* str);
 int comp_string_string(String* ptr, String* str);
 int comp_string_fmt(String* ptr, const char* fmt, ...);
@@ -61,5 +115,6 @@ String* pop_str_lst(StrLst* lst);
 String* peek_str_lst(StrLst* lst);
 void clear_str_lst(StrLst* lst);
 String* iterate_str_lst(StrLst* lst, int* post);
+int write_str_lst_fd(int fd, StrLst* lst);
 
 #endif  /* _STR_H_ */
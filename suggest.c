@@ -0,0 +1,360 @@
+/**
+ * @file suggest.c
+ *
+ * @brief Find the registered long options that are closest to an unknown
+ * one, so the error can say "did you mean". The Levenshtein distance is
+ * computed with the bit-parallel algorithm of Myers, as formulated by
+ * Hyyrö, which handles a whole column of the table in a few word operations.
+ * The search is bounded. Names that differ in length by more than the bound
+ * are skipped and a name is dropped as soon as it cannot come in under the
+ * bound. The bound shrinks to the best distance found so far.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-08
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <string.h>
+#include <stdint.h>
+
+#include "memory.h"
+#include "myassert.h"
+#include "parse.h"
+#include "trie.h"
+#include "suggest.h"
+
+// defined in cmdline.c, but not part of the public interface.
+Trie* get_long_trie();
+
+typedef struct {
+    uint64_t peq[256];  // bit i is set where pat[i] is the character
+    uint64_t high;      // bit for the last character of the pattern
+    size_t m;
+} _pattern_t_;
+
+typedef struct {
+    _pattern_t_ pat;
+    int max;            // only names at this distance or less are kept
+    int count;
+    int nout;
+    _cmd_opt_t_** out;
+} _suggest_t_;
+
+/**
+ * @brief Set up the match vectors for a pattern of at most 64 characters.
+ *
+ * @param pat
+ * @param str
+ * @param m
+ */
+static void init_pattern(_pattern_t_* pat, const char* str, size_t m) {
+
+    ASSERT(m > 0 && m <= 64);
+
+    memset(pat->peq, 0, sizeof(pat->peq));
+    for(size_t i = 0; i < m; i++)
+        pat->peq[(unsigned char)str[i]] |= (uint64_t)1 << i;
+
+    pat->high = (uint64_t)1 << (m - 1);
+    pat->m = m;
+}
+
+/**
+ * @brief Return the edit distance between the pattern and the text, or
+ * max+1 if it is greater than max. The score is the last row of the table
+ * and each remaining text character can lower it by at most one, so the
+ * loop stops as soon as the bound cannot be met.
+ *
+ * @param pat
+ * @param text
+ * @param n
+ * @param max
+ * @return int
+ */
+static int myers(const _pattern_t_* pat, const char* text, size_t n, int max) {
+
+    size_t m = pat->m;
+
+    if((m > n && (int)(m - n) > max) || (n > m && (int)(n - m) > max))
+        return max + 1;
+
+    uint64_t pv = (m == 64)? ~(uint64_t)0: (((uint64_t)1 << m) - 1);
+    uint64_t mv = 0;
+    int score = m;
+
+    for(size_t j = 0; j < n; j++) {
+        uint64_t eq = pat->peq[(unsigned char)text[j]];
+        uint64_t xv = eq | mv;
+        uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+        uint64_t ph = mv | ~(xh | pv);
+        uint64_t mh = pv & xh;
+
+        if(ph & pat->high)
+            score++;
+        else if(mh & pat->high)
+            score--;
+
+        if(score - (int)(n - j - 1) > max)
+            return max + 1;
+
+        // row zero of the table is 0, 1, 2, ... so it always steps up
+        ph = (ph << 1) | 1;
+        mh <<= 1;
+        pv = mh | ~(xv | ph);
+        mv = ph & xv;
+    }
+
+    return (score > max)? max + 1: score;
+}
+
+/**
+ * @brief Check one registered option against the word. Called for every
+ * key in the trie.
+ *
+ * @param data
+ * @param ctx
+ */
+static void check_option(void* data, void* ctx) {
+
+    _suggest_t_* sug = (_suggest_t_*)ctx;
+    _cmd_opt_t_* opt = (_cmd_opt_t_*)data;
+
+    int dist = myers(&sug->pat, opt->long_opt, strlen(opt->long_opt), sug->max);
+    if(dist < sug->max) {
+        // closer than anything so far, start over with a tighter bound
+        sug->max = dist;
+        sug->count = 0;
+    }
+
+    if(dist <= sug->max && sug->count < sug->nout)
+        sug->out[sug->count++] = opt;
+}
+
+/******************************************************************************
+ *
+ * Internal Interface
+ *
+ */
+
+/**
+ * @brief Return the Levenshtein distance between the pattern and the text.
+ * If it is more than max then max+1 is returned. The pattern cannot be
+ * longer than 64 characters.
+ *
+ * @param pat
+ * @param m
+ * @param text
+ * @param n
+ * @param max
+ * @return int
+ */
+int edit_distance(const char* pat, size_t m, const char* text, size_t n, int max) {
+
+    if(m == 0)
+        return ((int)n > max)? max + 1: (int)n;
+
+    _pattern_t_ p;
+    init_pattern(&p, pat, m);
+
+    return myers(&p, text, n, max);
+}
+
+/**
+ * @brief Find the long options that are closest to the word and store up to
+ * nout of them in out, in sorted order. Returns the number stored. Words
+ * that are longer than 64 characters are not matched.
+ *
+ * @param word
+ * @param out
+ * @param nout
+ * @return int
+ */
+int suggest_long(const char* word, _cmd_opt_t_** out, int nout) {
+
+    size_t m = strlen(word);
+    if(m == 0 || m > 64)
+        return 0;
+
+    // allow about one edit for every three characters typed
+    _suggest_t_ sug;
+    init_pattern(&sug.pat, word, m);
+    sug.max = (m < 4)? 1: (m < 8)? 2: 3;
+    sug.count = 0;
+    sug.nout = nout;
+    sug.out = out;
+
+    Trie* trie = get_long_trie();
+    iterate_trie(&trie->root, check_option, &sug);
+
+    return sug.count;
+}
+
+/******************************************************************************
+ *
+ * Test Code
+ *
+ */
+#ifdef TEST_SUGGEST
+
+#include <stdio.h>
+#include <time.h>
+
+#include "cmdline.h"
+
+// plain dynamic programming, to check the bit-parallel version.
+static int naive_distance(const char* a, int m, const char* b, int n) {
+
+    int* prev = _ALLOC_DS_ARRAY(int, n + 1);
+    int* crnt = _ALLOC_DS_ARRAY(int, n + 1);
+
+    for(int j = 0; j <= n; j++)
+        prev[j] = j;
+
+    for(int i = 1; i <= m; i++) {
+        crnt[0] = i;
+        for(int j = 1; j <= n; j++) {
+            int d = prev[j-1] + (a[i-1] != b[j-1]);
+            if(prev[j] + 1 < d)
+                d = prev[j] + 1;
+            if(crnt[j-1] + 1 < d)
+                d = crnt[j-1] + 1;
+            crnt[j] = d;
+        }
+        int* tmp = prev;
+        prev = crnt;
+        crnt = tmp;
+    }
+
+    int retv = prev[n];
+    _FREE(prev);
+    _FREE(crnt);
+    return retv;
+}
+
+static void random_word(char* buf, int len, int alpha) {
+
+    for(int i = 0; i < len; i++)
+        buf[i] = 'a' + rand() % alpha;
+    buf[len] = '\0';
+}
+
+static double elapsed(struct timespec* start) {
+
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e3 + (end.tv_nsec - start->tv_nsec) / 1e6;
+}
+
+int main() {
+
+    char a[80], b[80];
+    int failed = 0;
+
+    srand(1234);
+
+    // random pairs, small alphabets so that there are plenty of matches
+    for(int i = 0; i < 200000; i++) {
+        int m = 1 + rand() % 64;
+        int n = rand() % 70;
+        int max = rand() % 8;
+        random_word(a, m, 2 + rand() % 4);
+        random_word(b, n, 2 + rand() % 4);
+
+        int expect = naive_distance(a, m, b, n);
+        if(expect > max)
+            expect = max + 1;
+        int got = edit_distance(a, m, b, n, max);
+        if(got != expect) {
+            if(failed++ < 10)
+                printf("mismatch: '%s' '%s' max %d: got %d, expected %d\n", a, b, max, got, expect);
+        }
+    }
+    printf("random pairs checked, %d mismatches\n", failed);
+
+    // large synthetic registries
+    static const char* prefixes[] = { "enable", "disable", "with", "without", "max", "min", "use", "no" };
+    static const char* stems[] = { "cache", "thread", "buffer", "output", "input", "verbose", "warning",
+                                   "color", "format", "level", "timeout", "retry", "socket", "stream" };
+
+    for(int size = 1000; size <= 10000; size *= 10) {
+        init_cmdline("intro", "outtro", "test_suggest", "0.0");
+
+        char** names = _ALLOC_DS_ARRAY(char*, size);
+        for(int i = 0; i < size; i++) {
+            char tmp[80];
+            snprintf(tmp, sizeof(tmp), "%s-%s-%d", prefixes[i % 8], stems[(i / 8) % 14], i);
+            names[i] = (char*)_COPY_STR(tmp);
+            add_cmdline(0, names[i], names[i], "help", NULL, NULL, CMD_BOOL);
+        }
+        get_long_trie();
+
+        _cmd_opt_t_* out[MAX_SUGGEST];
+        int* typos = _ALLOC_DS_ARRAY(int, size);
+        char (*words)[80] = _ALLOC(80 * 200);
+        int loops = 200;
+        int wrong = 0;
+
+        // drop one character from a real name to make a typo
+        for(int i = 0; i < loops; i++) {
+            const char* name = names[rand() % size];
+            size_t skip = rand() % strlen(name);
+            memcpy(words[i], name, skip);
+            strcpy(&words[i][skip], &name[skip+1]);
+        }
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for(int i = 0; i < loops; i++)
+            typos[i] = suggest_long(words[i], out, MAX_SUGGEST);
+        double ms = elapsed(&start);
+
+        // check against a scan of every name with the same bound
+        for(int i = 0; i < loops; i++) {
+            size_t m = strlen(words[i]);
+            int max = (m < 4)? 1: (m < 8)? 2: 3;
+            int best = max + 1;
+            int nbest = 0;
+
+            for(int j = 0; j < size; j++) {
+                int d = edit_distance(words[i], m, names[j], strlen(names[j]), max);
+                if(d < best) {
+                    best = d;
+                    nbest = 0;
+                }
+                if(d == best)
+                    nbest++;
+            }
+
+            int count = suggest_long(words[i], out, MAX_SUGGEST);
+            if(count != typos[i] || count != ((nbest < MAX_SUGGEST)? nbest: MAX_SUGGEST))
+                wrong++;
+            for(int j = 0; j < count; j++) {
+                if(edit_distance(words[i], m, out[j]->long_opt, strlen(out[j]->long_opt), max) != best)
+                    wrong++;
+            }
+        }
+
+        printf("%d options: %d of %d suggestions wrong, %.3f ms per lookup\n",
+               size, wrong, loops, ms / loops);
+        if(wrong)
+            failed++;
+
+        _FREE(typos);
+        _FREE(words);
+        for(int i = 0; i < size; i++)
+            _FREE(names[i]);
+        _FREE(names);
+        uninit_cmdline();
+    }
+
+    if(failed) {
+        printf("FAILED\n");
+        return 1;
+    }
+
+    printf("finished\n");
+    return 0;
+}
+
+#endif
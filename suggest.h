@@ -0,0 +1,24 @@
+/**
+ * @file suggest.h
+ *
+ * @brief Internal interface for "did you mean" suggestions.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-08
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef _SUGGEST_H_
+#define _SUGGEST_H_
+
+#include <stdlib.h>
+
+#include "parse.h"
+
+#define MAX_SUGGEST 3
+
+int edit_distance(const char* pat, size_t m, const char* text, size_t n, int max);
+int suggest_long(const char* word, _cmd_opt_t_** out, int nout);
+
+#endif  /* _SUGGEST_H_ */
@@ -117,6 +117,10 @@ int main(int argc, char** argv) {
         printf("'%s', ", str);
     printf("\b\b \n");
 
+#ifdef USE_STATS
+    print_cmdline_stats(stdout);
+#endif
+
     //show_help();
     uninit_cmdline();
     return 0;
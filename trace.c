@@ -0,0 +1,121 @@
+/**
+ * @file trace.c
+ * 
+ * @brief Record how long the phases of the command line handling take, so 
+ * they can be exported in the Chrome trace format. The events are kept in a 
+ * ring that is allocated when the trace is started. Recording an event only 
+ * reads the clock and stores three words. When the ring is full the oldest 
+ * events are overwritten.
+ * 
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-19
+ * @copyright Copyright (c) 2024
+ * 
+ */
+#include <time.h>
+
+#include "memory.h"
+#include "myassert.h"
+#include "cmdline.h"
+#include "trace.h"
+
+static _trace_event_t_* ring = NULL;
+static int ring_size = 0;
+static int ring_count = 0;  // total events recorded, not wrapped
+
+static inline uint64_t now() {
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+/******************************************************************************
+ *
+ * Internal Interface
+ *
+ */
+
+/**
+ * @brief Return the start time of a phase, or 0 if there is no trace.
+ * 
+ * @return uint64_t 
+ */
+uint64_t trace_begin() {
+
+    return (ring != NULL)? now(): 0;
+}
+
+/**
+ * @brief Record a phase that started at the given time and ends now.
+ * 
+ * @param name 
+ * @param start 
+ */
+void trace_end(const char* name, uint64_t start) {
+
+    if(ring == NULL || start == 0)
+        return;
+
+    _trace_event_t_* ev = &ring[ring_count % ring_size];
+    ev->name = name;
+    ev->start = start;
+    ev->dur = now() - start;
+    ring_count++;
+}
+
+/**
+ * @brief Return the recorded events from the oldest to the newest. When 
+ * (*post == -1) then the end has been reached.
+ * 
+ * @param post 
+ * @return const _trace_event_t_* 
+ */
+const _trace_event_t_* iterate_trace(int* post) {
+
+    int first = (ring_count > ring_size)? ring_count - ring_size: 0;
+
+    if(ring == NULL || *post < 0 || first + *post >= ring_count) {
+        *post = -1;
+        return NULL;
+    }
+
+    return &ring[(first + (*post)++) % ring_size];
+}
+
+/******************************************************************************
+ *
+ * Public Interface
+ *
+ */
+
+/**
+ * @brief Start recording the phases. Room for nevents is allocated up 
+ * front. Call this before init_cmdline() so that the registration is timed. 
+ * Starting again discards the events that were recorded.
+ * 
+ * @param nevents 
+ */
+void start_cmdline_trace(int nevents) {
+
+    ASSERT(nevents > 0);
+
+    stop_cmdline_trace();
+    ring = _ALLOC_DS_ARRAY(_trace_event_t_, nevents);
+    ring_size = nevents;
+    ring_count = 0;
+}
+
+/**
+ * @brief Stop recording and free the events.
+ * 
+ */
+void stop_cmdline_trace() {
+
+    if(ring != NULL)
+        _FREE(ring);
+    ring = NULL;
+    ring_size = 0;
+    ring_count = 0;
+}
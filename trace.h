@@ -0,0 +1,30 @@
+/**
+ * @file trace.h
+ * 
+ * @brief Internal interface for the phase trace. A phase is timed by taking 
+ * the start time with trace_begin() and passing it to trace_end(), which 
+ * records one complete event. When no trace has been started, both of them 
+ * return at once.
+ * 
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-19
+ * @copyright Copyright (c) 2024
+ * 
+ */
+#ifndef _TRACE_H_
+#define _TRACE_H_
+
+#include <stdint.h>
+
+typedef struct {
+    const char* name;   // must be a string literal
+    uint64_t start;     // nanoseconds
+    uint64_t dur;
+} _trace_event_t_;
+
+uint64_t trace_begin();
+void trace_end(const char* name, uint64_t start);
+const _trace_event_t_* iterate_trace(int* post);
+
+#endif  /* _TRACE_H_ */
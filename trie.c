@@ -0,0 +1,247 @@
+/**
+ * @file trie.c
+ *
+ * @brief Prefix tree that maps strings to pointers. Each node keeps the
+ * number of keys beneath it, so a prefix can be checked for being unique or
+ * ambiguous in time that is proportional to the length of the prefix and
+ * not the number of keys.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-05
+ * @copyright Copyright (c) 2024
+ *
+ */
+#include <string.h>
+
+#include "memory.h"
+#include "trie.h"
+#include "myassert.h"
+
+/**
+ * @brief Free a node, its children and its siblings.
+ *
+ * @param node
+ */
+static void destroy_nodes(TrieNode* node) {
+
+    while(node != NULL) {
+        TrieNode* next = node->next;
+        destroy_nodes(node->child);
+        _FREE(node);
+        node = next;
+    }
+}
+
+/**
+ * @brief Find the child of the node that has the character. If create is
+ * set and there is no such child then one is added in sorted order.
+ *
+ * @param node
+ * @param ch
+ * @param create
+ * @return TrieNode*
+ */
+static TrieNode* find_child(TrieNode* node, unsigned char ch, int create) {
+
+    TrieNode** link = &node->child;
+
+    while(*link != NULL && (*link)->ch < ch)
+        link = &(*link)->next;
+
+    if(*link != NULL && (*link)->ch == ch)
+        return *link;
+
+    if(!create)
+        return NULL;
+
+    TrieNode* ptr = _ALLOC_DS(TrieNode);
+    ptr->ch = ch;
+    ptr->next = *link;
+    *link = ptr;
+
+    return ptr;
+}
+
+/******************************************************************************
+ *
+ * Public Interface
+ *
+ */
+
+/**
+ * @brief Create an empty trie.
+ *
+ * @return Trie*
+ */
+Trie* create_trie() {
+
+    return _ALLOC_DS(Trie);
+}
+
+/**
+ * @brief Free the trie. The data that was stored in it is not freed.
+ *
+ * @param trie
+ */
+void destroy_trie(Trie* trie) {
+
+    if(trie != NULL) {
+        destroy_nodes(trie->root.child);
+        _FREE(trie);
+    }
+}
+
+/**
+ * @brief Add a key to the trie. If the key is already there then the data
+ * that was stored first is kept. The data must not be NULL.
+ *
+ * @param trie
+ * @param key
+ * @param data
+ */
+void insert_trie(Trie* trie, const char* key, void* data) {
+
+    ASSERT(trie != NULL);
+    ASSERT(data != NULL);
+
+    if(find_trie(trie, key, strlen(key)) != NULL)
+        return;
+
+    TrieNode* node = &trie->root;
+    for(;;) {
+        node->count++;
+        if(node->count == 1)
+            node->only = data;
+
+        if(*key == '\0')
+            break;
+        node = find_child(node, (unsigned char)*key++, 1);
+    }
+
+    node->data = data;
+}
+
+/**
+ * @brief Return the data for the first len characters of the key, if that
+ * is exactly a key in the trie. Otherwise return NULL.
+ *
+ * @param trie
+ * @param key
+ * @param len
+ * @return void*
+ */
+void* find_trie(Trie* trie, const char* key, size_t len) {
+
+    TrieNode* node = prefix_trie(trie, key, len);
+
+    return (node != NULL)? node->data: NULL;
+}
+
+/**
+ * @brief Return the node that is reached by the first len characters of the
+ * key, or NULL if no key starts with them. The count in the node is the
+ * number of keys that have the prefix. If it is 1 then the data is in the
+ * only field.
+ *
+ * @param trie
+ * @param key
+ * @param len
+ * @return TrieNode*
+ */
+TrieNode* prefix_trie(Trie* trie, const char* key, size_t len) {
+
+    ASSERT(trie != NULL);
+
+    TrieNode* node = &trie->root;
+    for(size_t i = 0; i < len && node != NULL; i++)
+        node = find_child(node, (unsigned char)key[i], 0);
+
+    return node;
+}
+
+/**
+ * @brief Call the callback for the data of every key at or below the node,
+ * in sorted order of the keys.
+ *
+ * @param node
+ * @param cb
+ * @param ctx
+ */
+void iterate_trie(TrieNode* node, trie_callback cb, void* ctx) {
+
+    if(node == NULL)
+        return;
+
+    if(node->data != NULL)
+        (*cb)(node->data, ctx);
+
+    for(TrieNode* ptr = node->child; ptr != NULL; ptr = ptr->next)
+        iterate_trie(ptr, cb, ctx);
+}
+
+/******************************************************************************
+ *
+ * Test Code
+ *
+ */
+#ifdef TEST_TRIE
+
+#include <stdio.h>
+
+static void print_key(void* data, void* ctx) {
+
+    (void)ctx;
+    printf("   %s\n", (const char*)data);
+}
+
+static void dump_prefix(Trie* trie, const char* prefix) {
+
+    TrieNode* node = prefix_trie(trie, prefix, strlen(prefix));
+
+    printf("\nprefix '%s': ", prefix);
+    if(node == NULL)
+        printf("no match\n");
+    else if(node->data != NULL)
+        printf("exact '%s'\n", (const char*)node->data);
+    else if(node->count == 1)
+        printf("unique '%s'\n", (const char*)node->only);
+    else {
+        printf("ambiguous (%d)\n", node->count);
+        iterate_trie(node, print_key, NULL);
+    }
+}
+
+int main() {
+
+    char* const strs[] = {
+        "verbose",
+        "version",
+        "verb",
+        "add",
+        "append",
+        "help",
+        NULL
+    };
+
+    Trie* trie = create_trie();
+    for(int i = 0; strs[i] != NULL; i++)
+        insert_trie(trie, strs[i], strs[i]);
+
+    printf("all keys (%d):\n", trie->root.count);
+    iterate_trie(&trie->root, print_key, NULL);
+
+    dump_prefix(trie, "verb");      // exact
+    dump_prefix(trie, "verbo");     // unique verbose
+    dump_prefix(trie, "vers");      // unique version
+    dump_prefix(trie, "ver");       // ambiguous, 3
+    dump_prefix(trie, "a");         // ambiguous, 2
+    dump_prefix(trie, "h");         // unique help
+    dump_prefix(trie, "x");         // no match
+
+    destroy_trie(trie);
+    printf("\nfinished\n");
+    return 0;
+}
+
+#endif
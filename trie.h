@@ -0,0 +1,39 @@
+/**
+ * @file trie.h
+ *
+ * @brief Public interface to the prefix tree.
+ *
+ * @author Chuck Tilbury (chucktilbury@gmail.com)
+ * @version 0.0
+ * @date 2024-07-05
+ * @copyright Copyright (c) 2024
+ *
+ */
+#ifndef _TRIE_H_
+#define _TRIE_H_
+
+#include <stdlib.h>
+
+typedef struct _trie_node_ {
+    struct _trie_node_* child;  // first child
+    struct _trie_node_* next;   // next sibling, kept sorted by ch
+    void* data;     // not NULL if a key ends at this node
+    void* only;     // the data of the key below this node when count is 1
+    int count;      // number of keys that end at or below this node
+    unsigned char ch;
+} TrieNode;
+
+typedef struct {
+    TrieNode root;
+} Trie;
+
+typedef void (*trie_callback)(void* data, void* ctx);
+
+Trie* create_trie();
+void destroy_trie(Trie* trie);
+void insert_trie(Trie* trie, const char* key, void* data);
+void* find_trie(Trie* trie, const char* key, size_t len);
+TrieNode* prefix_trie(Trie* trie, const char* key, size_t len);
+void iterate_trie(TrieNode* node, trie_callback cb, void* ctx);
+
+#endif  /* _TRIE_H_ */